@@ -3,13 +3,249 @@
 #include <stdlib.h>
 
 #include "checkers.h"
+#include "checkers_trace.h"
+
+/* build with -DCHECKERS_DEBUG_HASH to check the incremental key and eval against a full recompute after every change */
+#ifdef CHECKERS_DEBUG_HASH
+#include <assert.h>
+#define CHECK_HASH(gameboard) assert((gameboard)->hash == boardComputeHash(gameboard) && (gameboard)->eval == boardComputeEval(gameboard))
+#else
+#define CHECK_HASH(gameboard) ((void) 0)
+#endif
 
 #define BLK "\e[0;30m"
 #define BWHT "\e[1;37m"
 #define CRESET "\e[0m"
 
-static inline int validIndex(struct Board* gameboard, int x, int y) { return x >= 0 && x < gameboard->boardSize && y >= 0 && y < gameboard->boardSize; }
-static int movePiece(struct Board* gameboard, int player, struct Point piecePos, struct Point newPos);
+/* shift amounts for the four diagonals, indexed by (dy > 0) * 2 + (dx > 0) */
+#define DIR_UP_LEFT     0
+#define DIR_UP_RIGHT    1
+#define DIR_DOWN_LEFT   2
+#define DIR_DOWN_RIGHT  3
+
+static const int dirShift[4] = {
+    -(CHECKERS_HALF_SIZE + 1),
+    -CHECKERS_HALF_SIZE,
+    CHECKERS_HALF_SIZE,
+    CHECKERS_HALF_SIZE + 1
+};
+
+/* the size is a constant, so the compiler folds these into two unsigned compares */
+static inline int validIndex(int x, int y) { return (unsigned) x < CHECKERS_BOARD_SIZE && (unsigned) y < CHECKERS_BOARD_SIZE; }
+/* the row each side's men are promoted on, indexed by player */
+static const uint64_t promotionRow[2] = {
+    (1ULL << CHECKERS_HALF_SIZE) - 1,
+    ((1ULL << CHECKERS_HALF_SIZE) - 1) << ((CHECKERS_HALF_SIZE - 1) * CHECKERS_ROW_PAIR_BITS + CHECKERS_HALF_SIZE)
+};
+
+/**
+ * Per-square geometry, built by the compiler for the board size of the build:
+ * the neighbour of every square in every direction and the ray a king sees
+ * from it on an empty board, both as masks, nothing off the board. The tables
+ * are padded to 64 squares so they can be spelled out without a loop; a
+ * diagonal is at most CHECKERS_BOARD_SIZE - 1 steps long.
+ */
+#define GEOMETRY_SQUARE(square) ((1ULL << (square)) & CHECKERS_BOARD_MASK)
+#define GEOMETRY_STEP_0(bits)   (((bits) >> (CHECKERS_HALF_SIZE + 1)) & CHECKERS_BOARD_MASK)
+#define GEOMETRY_STEP_1(bits)   (((bits) >> CHECKERS_HALF_SIZE) & CHECKERS_BOARD_MASK)
+#define GEOMETRY_STEP_2(bits)   (((bits) << CHECKERS_HALF_SIZE) & CHECKERS_BOARD_MASK)
+#define GEOMETRY_STEP_3(bits)   (((bits) << (CHECKERS_HALF_SIZE + 1)) & CHECKERS_BOARD_MASK)
+#define GEOMETRY_STEPS1(dir, bits)  GEOMETRY_STEP_##dir(bits)
+#define GEOMETRY_STEPS2(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS1(dir, bits))
+#define GEOMETRY_STEPS3(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS2(dir, bits))
+#define GEOMETRY_STEPS4(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS3(dir, bits))
+#define GEOMETRY_STEPS5(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS4(dir, bits))
+#define GEOMETRY_STEPS6(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS5(dir, bits))
+#define GEOMETRY_STEPS7(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS6(dir, bits))
+#define GEOMETRY_STEPS8(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS7(dir, bits))
+#define GEOMETRY_STEPS9(dir, bits)  GEOMETRY_STEPS1(dir, GEOMETRY_STEPS8(dir, bits))
+
+#define GEOMETRY_NEIGHBOR(dir, square)  GEOMETRY_STEPS1(dir, GEOMETRY_SQUARE(square))
+#define GEOMETRY_RAY(dir, square) ( \
+    GEOMETRY_STEPS1(dir, GEOMETRY_SQUARE(square)) | GEOMETRY_STEPS2(dir, GEOMETRY_SQUARE(square)) | \
+    GEOMETRY_STEPS3(dir, GEOMETRY_SQUARE(square)) | GEOMETRY_STEPS4(dir, GEOMETRY_SQUARE(square)) | \
+    GEOMETRY_STEPS5(dir, GEOMETRY_SQUARE(square)) | GEOMETRY_STEPS6(dir, GEOMETRY_SQUARE(square)) | \
+    GEOMETRY_STEPS7(dir, GEOMETRY_SQUARE(square)) | GEOMETRY_STEPS8(dir, GEOMETRY_SQUARE(square)) | \
+    GEOMETRY_STEPS9(dir, GEOMETRY_SQUARE(square)))
+
+#define GEOMETRY_ROW(entry, dir, row) \
+    entry(dir, (row) * 8 + 0), entry(dir, (row) * 8 + 1), entry(dir, (row) * 8 + 2), entry(dir, (row) * 8 + 3), \
+    entry(dir, (row) * 8 + 4), entry(dir, (row) * 8 + 5), entry(dir, (row) * 8 + 6), entry(dir, (row) * 8 + 7)
+#define GEOMETRY_TABLE(entry, dir) { \
+    GEOMETRY_ROW(entry, dir, 0), GEOMETRY_ROW(entry, dir, 1), GEOMETRY_ROW(entry, dir, 2), GEOMETRY_ROW(entry, dir, 3), \
+    GEOMETRY_ROW(entry, dir, 4), GEOMETRY_ROW(entry, dir, 5), GEOMETRY_ROW(entry, dir, 6), GEOMETRY_ROW(entry, dir, 7) }
+
+_Static_assert(CHECKERS_BOARD_SIZE - 1 <= 9, "GEOMETRY_RAY follows a diagonal for at most nine steps");
+
+static const uint64_t neighbors[4][64] = {
+    GEOMETRY_TABLE(GEOMETRY_NEIGHBOR, 0),
+    GEOMETRY_TABLE(GEOMETRY_NEIGHBOR, 1),
+    GEOMETRY_TABLE(GEOMETRY_NEIGHBOR, 2),
+    GEOMETRY_TABLE(GEOMETRY_NEIGHBOR, 3)
+};
+
+static const uint64_t rays[4][64] = {
+    GEOMETRY_TABLE(GEOMETRY_RAY, 0),
+    GEOMETRY_TABLE(GEOMETRY_RAY, 1),
+    GEOMETRY_TABLE(GEOMETRY_RAY, 2),
+    GEOMETRY_TABLE(GEOMETRY_RAY, 3)
+};
+
+static int movePiece(struct Board* gameboard, int player, struct Point piecePos, struct Point newPos, struct MoveUndo* undo);
+
+static uint64_t zobristPieces[4][CHECKERS_SQUARE_BITS];
+static uint64_t zobristSide;
+static int zobristReady = 0;
+
+static int32_t pieceSquare[4][CHECKERS_SQUARE_BITS];
+static int pieceSquareReady = 0;
+
+static inline struct Point squarePoint(int square);
+
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* fixed seed, so keys are the same on every run and can be stored in files */
+static void zobristInit(void) {
+    if (zobristReady) {
+        return;
+    }
+    uint64_t state = 0x436865636B657273ULL;
+    for (int kind = 0; kind < 4; kind++) {
+        for (int square = 0; square < CHECKERS_SQUARE_BITS; square++) {
+            zobristPieces[kind][square] = splitmix64(&state);
+        }
+    }
+    zobristSide = splitmix64(&state);
+    zobristReady = 1;
+}
+
+/**
+ * The terms the AI's evaluation used to compute for every piece at every leaf:
+ * material, how far a piece has advanced and a column term, rounded once to
+ * CHECKERS_EVAL_SCALE units so the incremental sum is exact.
+ */
+static void pieceSquareInit(void) {
+    if (pieceSquareReady) {
+        return;
+    }
+    for (int square = 0; square < CHECKERS_SQUARE_BITS; square++) {
+        if (!((CHECKERS_BOARD_MASK >> square) & 1)) {
+            continue;
+        }
+        struct Point pos = squarePoint(square);
+        double column = pos.x - (CHECKERS_BOARD_SIZE / 2 + 0.5);
+        column = (1 - 0.5 / (column < 0 ? -column : column)) * 20;
+        for (int kind = 0; kind < 4; kind++) {
+            int dark = kind >= PIECE_DARK_MAN;
+            double material = kind == PIECE_LIGHT_KING || kind == PIECE_DARK_KING ? 100.0 : 20.0;
+            double advance = (dark ? pos.y + 1 : CHECKERS_BOARD_SIZE - (pos.y + 1)) * 10.0 / CHECKERS_BOARD_SIZE;
+            double score = (material + advance + column) * CHECKERS_EVAL_SCALE;
+            int32_t rounded = (int32_t) (score + (score < 0 ? -0.5 : 0.5));
+            pieceSquare[kind][square] = dark ? rounded : -rounded;
+        }
+    }
+    pieceSquareReady = 1;
+}
+
+static inline uint64_t shiftBits(uint64_t bits, int shift) {
+    return (shift > 0 ? bits << shift : bits >> -shift) & CHECKERS_BOARD_MASK;
+}
+
+static inline int lowestSquare(uint64_t bits) {
+    return __builtin_ctzll(bits);
+}
+
+/* the square of bits that comes first going in direction dir, the up directions count down */
+static inline int nearestSquare(uint64_t bits, int dir) {
+    return dir >= DIR_DOWN_LEFT ? __builtin_ctzll(bits) : 63 - __builtin_clzll(bits);
+}
+
+/* the part of a ray in direction dir in front of the first of its squares in stops */
+static inline uint64_t rayBefore(uint64_t ray, int dir, uint64_t stops) {
+    uint64_t hit = ray & stops;
+    if (!hit) {
+        return ray;
+    }
+    int first = nearestSquare(hit, dir);
+    return ray ^ rays[dir][first] ^ (1ULL << first);
+}
+
+static inline int squareIndex(int x, int y) {
+    if (((x + y) & 1) == 0) {
+        return -1;
+    }
+    return (y >> 1) * CHECKERS_ROW_PAIR_BITS + (y & 1) * CHECKERS_HALF_SIZE + (x >> 1);
+}
+
+static inline struct Point squarePoint(int square) {
+    int pair = square / CHECKERS_ROW_PAIR_BITS;
+    int offset = square % CHECKERS_ROW_PAIR_BITS;
+    if (offset < CHECKERS_HALF_SIZE) {
+        return (struct Point){ .x = offset * 2 + 1, .y = pair * 2 };
+    }
+    return (struct Point){ .x = (offset - CHECKERS_HALF_SIZE) * 2, .y = pair * 2 + 1 };
+}
+
+/* PLAYER_ONE owns the light pieces, PLAYER_TWO the dark ones */
+static inline uint64_t playerPieces(struct Board* gameboard, int player) {
+    return gameboard->pieces[player * 2] | gameboard->pieces[player * 2 + 1];
+}
+
+static inline int pieceAt(struct Board* gameboard, int square) {
+    uint64_t bit = 1ULL << square;
+    if (gameboard->empty & bit) {
+        return PIECE_NONE;
+    }
+    for (int kind = PIECE_LIGHT_MAN; kind < PIECE_NONE; kind++) {
+        if (gameboard->pieces[kind] & bit) {
+            return kind;
+        }
+    }
+    return PIECE_NONE;
+}
+
+static inline char pieceChar(struct Board* gameboard, int kind) {
+    switch (kind) {
+        case PIECE_LIGHT_MAN:   return gameboard->pieceLightMan;
+        case PIECE_LIGHT_KING:  return gameboard->pieceLightKing;
+        case PIECE_DARK_MAN:    return gameboard->pieceDarkMan;
+        case PIECE_DARK_KING:   return gameboard->pieceDarkKing;
+        default:                return gameboard->blank;
+    }
+}
+
+/* every change to the position goes through these two, so the char grid never drifts from the bitboards */
+static inline void putPiece(struct Board* gameboard, int kind, int square) {
+    uint64_t bit = 1ULL << square;
+    struct Point pos = squarePoint(square);
+    gameboard->pieces[kind] |= bit;
+    gameboard->empty &= ~bit;
+    gameboard->hash ^= zobristPieces[kind][square];
+    gameboard->eval += pieceSquare[kind][square];
+    gameboard->board[pos.y][pos.x] = pieceChar(gameboard, kind);
+}
+
+static inline void setSideToMove(struct Board* gameboard, int player) {
+    if (gameboard->sideToMove != player) {
+        gameboard->sideToMove = player;
+        gameboard->hash ^= zobristSide;
+    }
+}
+
+static inline void removePiece(struct Board* gameboard, int kind, int square) {
+    uint64_t bit = 1ULL << square;
+    struct Point pos = squarePoint(square);
+    gameboard->pieces[kind] &= ~bit;
+    gameboard->empty |= bit;
+    gameboard->hash ^= zobristPieces[kind][square];
+    gameboard->eval -= pieceSquare[kind][square];
+    gameboard->board[pos.y][pos.x] = gameboard->blank;
+}
 
 /**
  * BOARD LOGIC
@@ -17,14 +253,13 @@ static int movePiece(struct Board* gameboard, int player, struct Point piecePos,
  * 
  */
 
-int boardInit(struct Board* gameboard) {
-    if (!gameboard) {
-        return 0;
-    }
-    memset(gameboard, '.', sizeof(struct Board));
+/* an empty board with light to move */
+static void clearBoard(struct Board* gameboard) {
+    zobristInit();
+    pieceSquareInit();
+    memset(gameboard, 0, sizeof(struct Board));
+    gameboard->sideToMove = CHECKERS_PLAYER_ONE;
     gameboard->boardSize = CHECKERS_BOARD_SIZE;
-    gameboard->remainingLightPieces = CHECKERS_PIECES_AMOUNT;
-    gameboard->remainingDarkPieces = CHECKERS_PIECES_AMOUNT;
 
     gameboard->pieceLightMan = 'M';
     gameboard->pieceLightKing ='K';
@@ -34,13 +269,23 @@ int boardInit(struct Board* gameboard) {
 
     gameboard->blank = '.';
 
+    memset(gameboard->board, gameboard->blank, sizeof(gameboard->board));
+    gameboard->empty = CHECKERS_BOARD_MASK;
+}
+
+int boardInit(struct Board* gameboard) {
+    if (!gameboard) {
+        return 0;
+    }
+    clearBoard(gameboard);
+    gameboard->remainingLightPieces = CHECKERS_PIECES_AMOUNT;
+    gameboard->remainingDarkPieces = CHECKERS_PIECES_AMOUNT;
+
     // adding dark pieces
     for (int i = 0; i < (CHECKERS_BOARD_SIZE - 2) / 2; i++) {
         for (int j = 0; j < CHECKERS_BOARD_SIZE; j++) {
             if ((i + j) % 2 == 1) {
-                gameboard->board[i][j] = gameboard->pieceDarkMan;
-            } else {
-                gameboard->board[i][j] = gameboard->blank;
+                putPiece(gameboard, PIECE_DARK_MAN, squareIndex(j, i));
             }
         }
     }
@@ -49,12 +294,11 @@ int boardInit(struct Board* gameboard) {
     for (int i = (CHECKERS_BOARD_SIZE - 2) / 2 + 2; i < CHECKERS_BOARD_SIZE; i++) {
         for (int j = 0; j < CHECKERS_BOARD_SIZE; j++) {
             if ((i + j) % 2 == 1) {
-                gameboard->board[i][j] = gameboard->pieceLightMan;
-            } else {
-                gameboard->board[i][j] = gameboard->blank;
+                putPiece(gameboard, PIECE_LIGHT_MAN, squareIndex(j, i));
             }
         }
     }
+    CHECK_HASH(gameboard);
     return 1;
 }
 
@@ -62,21 +306,110 @@ int boardTryMoveOrCapture(struct Board* gameboard, int player, struct Point piec
     if (!gameboard) {
         return CHECKERS_NULL_BOARD;
     } else if (player == CHECKERS_PLAYER_ONE || player == CHECKERS_PLAYER_TWO) {
-        return movePiece(gameboard, player, piecePos, newPos);
+        return movePiece(gameboard, player, piecePos, newPos, NULL);
     } else {
         return CHECKERS_INVALID_PLAYER;
     }
 }
 
+
+static inline void applyMove(struct Board* gameboard, struct Move move, struct MoveUndo* undo) {
+    int kind = pieceAt(gameboard, move.from);
+    undo->move = move;
+    undo->piece = kind;
+    undo->capturedPiece = PIECE_NONE;
+    undo->promoted = 0;
+    undo->chained = 0;
+    if (move.captured != CHECKERS_NO_SQUARE) {
+        int captured = pieceAt(gameboard, move.captured);
+        undo->capturedPiece = captured;
+        if (captured < PIECE_DARK_MAN) {
+            gameboard->remainingLightPieces -= 1;
+        } else {
+            gameboard->remainingDarkPieces -= 1;
+        }
+        removePiece(gameboard, captured, move.captured);
+    }
+    removePiece(gameboard, kind, move.from);
+    putPiece(gameboard, kind, move.to);
+}
+
+void boardMakeMove(struct Board* gameboard, struct Move move, struct MoveUndo* undo) {
+    applyMove(gameboard, move, undo);
+    int kind = undo->piece;
+    if ((kind == PIECE_LIGHT_MAN || kind == PIECE_DARK_MAN) && (promotionRow[kind >> 1] & (1ULL << move.to))) {
+        removePiece(gameboard, kind, move.to);
+        putPiece(gameboard, kind + 1, move.to);
+        undo->promoted = 1;
+    }
+    setSideToMove(gameboard, !gameboard->sideToMove);
+    CHECK_HASH(gameboard);
+}
+
+static inline void unapplyMove(struct Board* gameboard, const struct MoveUndo* undo) {
+    removePiece(gameboard, undo->promoted ? undo->piece + 1 : undo->piece, undo->move.to);
+    putPiece(gameboard, undo->piece, undo->move.from);
+    if (undo->move.captured != CHECKERS_NO_SQUARE) {
+        putPiece(gameboard, undo->capturedPiece, undo->move.captured);
+        if (undo->capturedPiece < PIECE_DARK_MAN) {
+            gameboard->remainingLightPieces += 1;
+        } else {
+            gameboard->remainingDarkPieces += 1;
+        }
+    }
+}
+
+static int canCaptureFrom(struct Board* gameboard, int player, uint64_t men, uint64_t kings);
+
+void boardMakeChainedMove(struct Board* gameboard, struct Move move, int forceCapture, struct MoveUndo* undo) {
+    TRACE_SCOPE("boardMakeChainedMove");
+    if (!forceCapture || move.captured == CHECKERS_NO_SQUARE) {
+        boardMakeMove(gameboard, move, undo);
+        return;
+    }
+    applyMove(gameboard, move, undo);
+    int player = undo->piece >> 1;
+    uint64_t bit = 1ULL << move.to;
+    if (canCaptureFrom(gameboard, player, gameboard->pieces[player * 2] & bit, gameboard->pieces[player * 2 + 1] & bit)) {
+        undo->chained = 1;
+        CHECK_HASH(gameboard);
+        return;
+    }
+    int kind = undo->piece;
+    if ((kind == PIECE_LIGHT_MAN || kind == PIECE_DARK_MAN) && (promotionRow[kind >> 1] & bit)) {
+        removePiece(gameboard, kind, move.to);
+        putPiece(gameboard, kind + 1, move.to);
+        undo->promoted = 1;
+    }
+    setSideToMove(gameboard, !gameboard->sideToMove);
+    CHECK_HASH(gameboard);
+}
+
+void boardUnmakeMove(struct Board* gameboard, const struct MoveUndo* undo) {
+    unapplyMove(gameboard, undo);
+    if (!undo->chained) {
+        setSideToMove(gameboard, !gameboard->sideToMove);
+    }
+    CHECK_HASH(gameboard);
+}
+
 void boardTryTurnKing(struct Board* gameboard, struct Point piecePos) {
-    if (!validIndex(gameboard, piecePos.x, piecePos.y)) {
+    if (!validIndex(piecePos.x, piecePos.y)) {
         return;
     }
-    if (piecePos.y == 0 && gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceLightMan) {
-        gameboard->board[piecePos.y][piecePos.x] = gameboard->pieceLightKing;
-    } else if (piecePos.y == CHECKERS_BOARD_SIZE - 1 && gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceDarkMan) {
-        gameboard->board[piecePos.y][piecePos.x] = gameboard->pieceDarkKing;
+    int square = squareIndex(piecePos.x, piecePos.y);
+    if (square < 0) {
+        return;
     }
+    int kind = pieceAt(gameboard, square);
+    if (piecePos.y == 0 && kind == PIECE_LIGHT_MAN) {
+        removePiece(gameboard, PIECE_LIGHT_MAN, square);
+        putPiece(gameboard, PIECE_LIGHT_KING, square);
+    } else if (piecePos.y == CHECKERS_BOARD_SIZE - 1 && kind == PIECE_DARK_MAN) {
+        removePiece(gameboard, PIECE_DARK_MAN, square);
+        putPiece(gameboard, PIECE_DARK_KING, square);
+    }
+    CHECK_HASH(gameboard);
 }
 
 int boardRemainingPiecesTotal(struct Board* gameboard) {
@@ -99,179 +432,195 @@ int boardRemainingPiecesPlayer(struct Board* gameboard, int player) {
     }
 }
 
-static inline int canCapture(struct Board* gameboard, char enemy, char enemyKing, struct Point enemyPos, struct Point moveVec) {
-    return (
-        (gameboard->board[enemyPos.y][enemyPos.x] == enemy || gameboard->board[enemyPos.y][enemyPos.x] == enemyKing) &&
-        validIndex(gameboard, enemyPos.x + moveVec.x, enemyPos.y + moveVec.y) &&
-        gameboard->board[enemyPos.y + moveVec.y][enemyPos.x + moveVec.x] == gameboard->blank
-    );
-}
 
-int boardGetAvailableMovesForPiece(struct Board* gameboard, struct Point piecePos, struct Point** out, int includeBackwardsCaptures) {
-    if (!gameboard || !out) {
-        return CHECKERS_NULL_BOARD;
+static inline void pushMove(struct MoveList* list, int from, int to, int captured) {
+    if (list->size < CHECKERS_MAX_MOVES) {
+        list->moves[list->size++] = (struct Move){ .from = from, .to = to, .captured = captured };
     }
-    if (!validIndex(gameboard, piecePos.x, piecePos.y)) {
-        *out = NULL;
-        return CHECKERS_INVALID_MOVE;
+}
+
+/* one move from `from` to every square of a ray in direction dir, nearest first */
+static inline void pushRay(struct MoveList* list, int from, uint64_t squares, int dir, int captured) {
+    while (squares) {
+        int to = nearestSquare(squares, dir);
+        squares ^= 1ULL << to;
+        pushMove(list, from, to, captured);
     }
-    if (gameboard->board[piecePos.y][piecePos.x] == gameboard->blank) {
-        *out = NULL;
-        return 0;
+}
+
+/**
+ * Appends the moves of the piece on `square` to list.
+ * Men step forward or jump an adjacent enemy; kings slide along each diagonal and may
+ * jump the first enemy on it, landing on any empty square behind it. Both read the
+ * compile-time neighbour and ray tables rather than walking the board.
+ */
+static void pieceMoves(struct Board* gameboard, int square, int includeBackwardsCaptures, int capturesOnly, struct MoveList* list) {
+    int kind = pieceAt(gameboard, square);
+    if (kind == PIECE_NONE) {
+        return;
     }
-    // finished!!
-    int illegalY;
-    int bufCap = 2;
-    if (includeBackwardsCaptures) {
-        bufCap = 4;
-    }
-    char enemy, enemyKing;
-    if (gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceLightMan) {
-        enemy = gameboard->pieceDarkMan;
-        enemyKing = gameboard->pieceDarkKing;
-        illegalY = 1;
-    } else if (gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceDarkMan) {
-        enemy = gameboard->pieceLightMan;
-        enemyKing = gameboard->pieceLightKing;
-        illegalY = -1;
+    int player = kind >> 1;
+    uint64_t enemies = playerPieces(gameboard, !player);
+    uint64_t empty = gameboard->empty;
+
+    if (kind == PIECE_LIGHT_MAN || kind == PIECE_DARK_MAN) {
+        for (int dir = 0; dir < 4; dir++) {
+            int forward = (dir >> 1) == player;
+            if (!forward && !includeBackwardsCaptures) {
+                continue;
+            }
+            uint64_t step = neighbors[dir][square];
+            if (step & enemies) {
+                uint64_t jump = neighbors[dir][lowestSquare(step)] & empty;
+                if (jump) {
+                    pushMove(list, square, lowestSquare(jump), lowestSquare(step));
+                    continue;
+                }
+            }
+            if (forward && !capturesOnly && (step & empty)) {
+                pushMove(list, square, lowestSquare(step), CHECKERS_NO_SQUARE);
+            }
+        }
     } else {
-        if (gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceLightKing) {
-            enemy = gameboard->pieceDarkMan;
-            enemyKing = gameboard->pieceDarkKing;
-        } else if (gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceDarkKing) {
-            enemy = gameboard->pieceLightMan;
-            enemyKing = gameboard->pieceLightKing;
-        } else {
-            *out = NULL;
-            return 0;
+        for (int dir = 0; dir < 4; dir++) {
+            uint64_t ray = rays[dir][square];
+            uint64_t open = rayBefore(ray, dir, ~empty);
+            if (!capturesOnly) {
+                pushRay(list, square, open, dir, CHECKERS_NO_SQUARE);
+            }
+            uint64_t rest = ray ^ open;
+            if (!rest) {
+                continue;
+            }
+            int first = nearestSquare(rest, dir);
+            if ((enemies >> first) & 1) {
+                pushRay(list, square, rayBefore(rays[dir][first], dir, ~empty), dir, first);
+            }
         }
-        illegalY = 0;
-        bufCap = 12;
     }
+}
 
-    int count = 0;
-    double resizeFact = 1.5;
-    struct Point* buf = malloc(sizeof(struct Point) * bufCap);
-    if (buf == NULL) {
-        *out = NULL;
+size_t boardGeneratePieceMoves(struct Board* gameboard, struct Point piecePos, int includeBackwardsCaptures, struct MoveList* list) {
+    if (!list) {
         return 0;
     }
-    if (gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceLightMan || gameboard->board[piecePos.y][piecePos.x] == gameboard->pieceDarkMan) {
-        struct Point left = { .x = piecePos.x - 1, .y = piecePos.y + (illegalY * -1)};
-        struct Point right = { .x = piecePos.x + 1, .y = left.y};
-        if (validIndex(gameboard, left.x, left.y)) {
-            if (canCapture(gameboard, enemy, enemyKing, left, (struct Point){ .x = -1, .y = illegalY * -1})) {
-                buf[count++] = (struct Point) {
-                    .x = left.x - 1,
-                    .y = left.y + (illegalY * -1)
-                };
-            } else if (gameboard->board[left.y][left.x] == gameboard->blank) {
-                buf[count++] = left;
-            }
-        }
-        if (validIndex(gameboard, right.x, right.y)) {
-            if (canCapture(gameboard, enemy, enemyKing, right, (struct Point){ .x = 1, .y = illegalY * -1})) {
-                buf[count++] = (struct Point) {
-                    .x = right.x + 1,
-                    .y = right.y + (illegalY * -1)
-                };
-            } else if (gameboard->board[right.y][right.x] == gameboard->blank) {
-                buf[count++] = right;
-            }
-        }
-        if (includeBackwardsCaptures) {
-            struct Point left2 = { .x = piecePos.x - 1, .y = piecePos.y + illegalY};
-            struct Point right2 = { .x = piecePos.x + 1, .y = left2.y};
-            if (validIndex(gameboard, left2.x, left2.y) && canCapture(gameboard, enemy, enemyKing, left2, (struct Point){ .x = -1, .y = illegalY})) {
-                buf[count++] = (struct Point) {
-                    .x = left2.x - 1,
-                    .y = left2.y + illegalY
-                };
-            }
-            if (validIndex(gameboard, right2.x, right2.y) && canCapture(gameboard, enemy, enemyKing, right2, (struct Point){ .x = 1, .y = illegalY})) {
-                buf[count++] = (struct Point) {
-                    .x = right2.x + 1,
-                    .y = right2.y + illegalY
-                };
+    list->size = 0;
+    if (!gameboard || !validIndex(piecePos.x, piecePos.y)) {
+        return 0;
+    }
+    int square = squareIndex(piecePos.x, piecePos.y);
+    if (square >= 0) {
+        pieceMoves(gameboard, square, includeBackwardsCaptures, 0, list);
+    }
+    return list->size;
+}
+
+/**
+ * Men are generated for all pieces at once, one diagonal at a time, from the
+ * shifted masks; kings still walk their rays one piece at a time.
+ */
+static size_t generateMoves(struct Board* gameboard, int player, int forceCapture, int capturesOnly, struct MoveList* list) {
+    uint64_t men = gameboard->pieces[player * 2];
+    uint64_t kings = gameboard->pieces[player * 2 + 1];
+    uint64_t enemies = playerPieces(gameboard, !player);
+    uint64_t empty = gameboard->empty;
+
+    for (int dir = 0; dir < 4; dir++) {
+        int shift = dirShift[dir];
+        int forward = (dir >> 1) == player;
+        if (forward || forceCapture) {
+            uint64_t jumps = shiftBits(shiftBits(men, shift) & enemies, shift) & empty;
+            while (jumps) {
+                int to = lowestSquare(jumps);
+                jumps &= jumps - 1;
+                pushMove(list, to - 2 * shift, to, to - shift);
             }
         }
-    } else {
-        int index = 0;
-        struct Point moveVecs[4] = {
-            { .x = -1, .y = -1 },
-            { .x = -1, .y = 1 },
-            { .x = 1, .y = -1 },
-            { .x = 1, .y = 1 }
-        };
-        struct Point positions[4] = {
-            {piecePos.x + moveVecs[0].x, .y = piecePos.y + moveVecs[0].y},
-            {piecePos.x + moveVecs[1].x, .y = piecePos.y + moveVecs[1].y},
-            {piecePos.x + moveVecs[2].x, .y = piecePos.y + moveVecs[2].y},
-            {piecePos.x + moveVecs[3].x, .y = piecePos.y + moveVecs[3].y}
-        };
-        int hasCaptured[4] = {0, 0, 0, 0};
-
-        while (index < 4) {
-            while (1) {
-                if (!validIndex(gameboard, positions[index].x, positions[index].y)) {
-                    break;
-                }
-                if (canCapture(gameboard, enemy, enemyKing, positions[index], moveVecs[index])) {
-                    if (hasCaptured[index]) {
-                        break;
-                    }
-                    hasCaptured[index] = 1;
-                    buf[count++] = (struct Point) {
-                        .x = positions[index].x + moveVecs[index].x,
-                        .y = positions[index].y + moveVecs[index].y
-                    };
-                    positions[index].x += 2 * moveVecs[index].x;
-                    positions[index].y += 2 * moveVecs[index].y;
-                } else if (gameboard->board[positions[index].y][positions[index].x] == gameboard->blank) {
-                    buf[count++] = positions[index];
-                    positions[index].x += moveVecs[index].x;
-                    positions[index].y += moveVecs[index].y;
-                } else {
-                    break;
-                }
-                if (count >= bufCap) {
-                    bufCap *= resizeFact;
-                    struct Point* tmp = realloc(buf, sizeof(struct Point) * bufCap);
-                    if (tmp == NULL) {
-                        free(buf);
-                        *out = NULL;
-                        return 0;
-                    }
-                    buf = tmp;
-                }
+        if (forward && !capturesOnly) {
+            uint64_t steps = shiftBits(men, shift) & empty;
+            while (steps) {
+                int to = lowestSquare(steps);
+                steps &= steps - 1;
+                pushMove(list, to - shift, to, CHECKERS_NO_SQUARE);
             }
-            index++;
         }
     }
+    while (kings) {
+        int square = lowestSquare(kings);
+        kings &= kings - 1;
+        pieceMoves(gameboard, square, forceCapture, capturesOnly, list);
+    }
+    return list->size;
+}
+
+size_t boardGenerateMoves(struct Board* gameboard, int player, int forceCapture, struct MoveList* list) {
+    TRACE_SCOPE("boardGenerateMoves");
+    if (!list) {
+        return 0;
+    }
+    list->size = 0;
+    if (!gameboard || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+        return 0;
+    }
+    int capturesOnly = forceCapture && canCaptureFrom(gameboard, player, gameboard->pieces[player * 2], gameboard->pieces[player * 2 + 1]);
+    return generateMoves(gameboard, player, forceCapture, capturesOnly, list);
+}
+
+size_t boardGenerateCaptures(struct Board* gameboard, int player, int forceCapture, struct MoveList* list) {
+    TRACE_SCOPE("boardGenerateCaptures");
+    if (!list) {
+        return 0;
+    }
+    list->size = 0;
+    if (!gameboard || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+        return 0;
+    }
+    return generateMoves(gameboard, player, forceCapture, 1, list);
+}
+
+size_t boardGenerateChainMoves(struct Board* gameboard, int square, int forceCapture, struct MoveList* list) {
+    TRACE_SCOPE("boardGenerateChainMoves");
+    if (!list) {
+        return 0;
+    }
+    list->size = 0;
+    if (!gameboard || square < 0 || square >= CHECKERS_SQUARE_BITS) {
+        return 0;
+    }
+    pieceMoves(gameboard, square, forceCapture, 1, list);
+    return list->size;
+}
+
+int boardGetAvailableMovesForPiece(struct Board* gameboard, struct Point piecePos, struct Point** out, int includeBackwardsCaptures) {
+    TRACE_SCOPE("boardGetAvailableMovesForPiece");
+    if (!gameboard || !out) {
+        return CHECKERS_NULL_BOARD;
+    }
+    if (!validIndex(piecePos.x, piecePos.y)) {
+        *out = NULL;
+        return CHECKERS_INVALID_MOVE;
+    }
+    struct MoveList list;
+    int count = boardGeneratePieceMoves(gameboard, piecePos, includeBackwardsCaptures, &list);
     if (count == 0) {
         *out = NULL;
-        free(buf);
-    } else {
-        struct Point* tmp = realloc(buf, sizeof(struct Point) * count);
-        if (tmp == NULL) {
-            free(buf);
-            *out = NULL;
-            return 0;
-        }
-        *out = tmp;
+        return 0;
     }
+    struct Point* buf = malloc(sizeof(struct Point) * count);
+    if (buf == NULL) {
+        *out = NULL;
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        buf[i] = squarePoint(list.moves[i].to);
+    }
+    *out = buf;
     return count;
 }
 
 struct Moves* boardGetAvailableMovesForPlayer(struct Board* gameboard, int player, int forceCapture, size_t* out_size) {
-    char piece, king;
-    if (player == CHECKERS_PLAYER_ONE) {
-        piece = gameboard->pieceLightMan;
-        king = gameboard->pieceLightKing;
-    } else if (player == CHECKERS_PLAYER_TWO) {
-        piece = gameboard->pieceDarkMan;
-        king = gameboard->pieceDarkKing;
-    } else {
+    TRACE_SCOPE("boardGetAvailableMovesForPlayer");
+    if (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO) {
         *out_size = 0;
         return NULL;
     }
@@ -284,27 +633,27 @@ struct Moves* boardGetAvailableMovesForPlayer(struct Board* gameboard, int playe
         *out_size = 0;
         return NULL;
     }
-    for (int y = 0; y < gameboard->boardSize; y++) {
-        for (int x = 0; x < gameboard->boardSize; x++) {
-            if (gameboard->board[y][x] == piece || gameboard->board[y][x] == king) {
-                struct Moves mov = {0};
-                mov.from = (struct Point){ .x = x, .y = y };
-                int count = boardGetAvailableMovesForPiece(gameboard, mov.from, &mov.to, forceCapture);
-                if (count > 0 && mov.to != NULL) {
-                    mov.to_size = count;
-                    list[size++] = mov;
-                }
-                if (size >= cap) {
-                    cap *= resizeFact;
-                    struct Moves* tmp = realloc(list, sizeof(struct Moves) * cap);
-                    if (!tmp) {
-                        free(list);
-                        *out_size = 0;
-                        return NULL;
-                    }
-                    list = tmp;
-                }
+    uint64_t own = playerPieces(gameboard, player);
+    while (own) {
+        int square = lowestSquare(own);
+        own &= own - 1;
+
+        struct Moves mov = {0};
+        mov.from = squarePoint(square);
+        int count = boardGetAvailableMovesForPiece(gameboard, mov.from, &mov.to, forceCapture);
+        if (count > 0 && mov.to != NULL) {
+            mov.to_size = count;
+            list[size++] = mov;
+        }
+        if (size >= cap) {
+            cap *= resizeFact;
+            struct Moves* tmp = realloc(list, sizeof(struct Moves) * cap);
+            if (!tmp) {
+                free(list);
+                *out_size = 0;
+                return NULL;
             }
+            list = tmp;
         }
     }
     if (size == 0) {
@@ -323,99 +672,269 @@ struct Moves* boardGetAvailableMovesForPlayer(struct Board* gameboard, int playe
     return list;
 }
 
+/**
+ * Men may capture in all four directions here. Kings are handled all at once
+ * by flooding each diagonal through empty squares and checking whether the
+ * first piece hit is an enemy with an empty square behind it.
+ */
+static int canCaptureFrom(struct Board* gameboard, int player, uint64_t men, uint64_t kings) {
+    uint64_t enemies = playerPieces(gameboard, !player);
+    uint64_t empty = gameboard->empty;
+    for (int dir = 0; dir < 4; dir++) {
+        int shift = dirShift[dir];
+        if (shiftBits(shiftBits(men, shift) & enemies, shift) & empty) {
+            return 1;
+        }
+        uint64_t ray = shiftBits(kings, shift);
+        uint64_t frontier = ray & empty;
+        while (frontier) {
+            frontier = shiftBits(frontier, shift);
+            ray |= frontier;
+            frontier &= empty;
+        }
+        if (shiftBits(ray & enemies, shift) & empty) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 int boardCheckIfPieceCanCapture(struct Board* gameboard, int player, struct Point pos) {
-    if (!gameboard || !validIndex(gameboard, pos.x, pos.y) || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+    if (!gameboard || !validIndex(pos.x, pos.y) || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+        return 0;
+    }
+    int square = squareIndex(pos.x, pos.y);
+    if (square < 0) {
         return 0;
     }
-    char playerPiece = gameboard->board[pos.y][pos.x];
-    char playerMan, playerKing;
-    char enemyMan, enemyKing;
+    uint64_t bit = 1ULL << square;
+    return canCaptureFrom(gameboard, player, gameboard->pieces[player * 2] & bit, gameboard->pieces[player * 2 + 1] & bit);
+}
 
-    if (player == CHECKERS_PLAYER_ONE) {
-        playerMan = gameboard->pieceLightMan;
-        playerKing = gameboard->pieceLightKing;
+int boardCheckIfPlayerCanCapture(struct Board* gameboard, int player) {
+    TRACE_SCOPE("boardCheckIfPlayerCanCapture");
+    if (!gameboard || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+        return 0;
+    }
+    return canCaptureFrom(gameboard, player, gameboard->pieces[player * 2], gameboard->pieces[player * 2 + 1]);
+}
 
-        enemyMan = gameboard->pieceDarkMan;
-        enemyKing = gameboard->pieceDarkKing;
-    } else if (player == CHECKERS_PLAYER_TWO) {
-        playerMan = gameboard->pieceDarkMan;
-        playerKing = gameboard->pieceDarkKing;
+int boardSquareFromPoint(struct Point pos) {
+    if (pos.x < 0 || pos.x >= CHECKERS_BOARD_SIZE || pos.y < 0 || pos.y >= CHECKERS_BOARD_SIZE) {
+        return -1;
+    }
+    return squareIndex(pos.x, pos.y);
+}
 
-        enemyMan = gameboard->pieceLightMan;
-        enemyKing = gameboard->pieceLightKing;
-    } else {
+struct Point boardPointFromSquare(int square) {
+    if (square < 0 || square >= CHECKERS_SQUARE_BITS || !((CHECKERS_BOARD_MASK >> square) & 1)) {
+        return (struct Point){ .x = -1, .y = -1 };
+    }
+    return squarePoint(square);
+}
+
+uint64_t boardComputeHash(struct Board* gameboard) {
+    if (!gameboard) {
         return 0;
     }
+    zobristInit();
+    uint64_t hash = gameboard->sideToMove == CHECKERS_PLAYER_TWO ? zobristSide : 0;
+    for (int kind = 0; kind < 4; kind++) {
+        uint64_t bits = gameboard->pieces[kind];
+        while (bits) {
+            hash ^= zobristPieces[kind][lowestSquare(bits)];
+            bits &= bits - 1;
+        }
+    }
+    return hash;
+}
+
+int32_t boardComputeEval(struct Board* gameboard) {
+    if (!gameboard) {
+        return 0;
+    }
+    pieceSquareInit();
+    int32_t eval = 0;
+    for (int kind = 0; kind < 4; kind++) {
+        uint64_t bits = gameboard->pieces[kind];
+        while (bits) {
+            eval += pieceSquare[kind][lowestSquare(bits)];
+            bits &= bits - 1;
+        }
+    }
+    return eval;
+}
+
+int32_t boardSquareScore(int kind, int square) {
+    if (kind < PIECE_LIGHT_MAN || kind > PIECE_DARK_KING || square < 0 || square >= CHECKERS_SQUARE_BITS) {
+        return 0;
+    }
+    pieceSquareInit();
+    return pieceSquare[kind][square];
+}
 
-    if (playerPiece == playerKing) {
-        int index = 0;
-        struct Point moveVecs[4] = {
-            { .x = -1, .y = -1 },
-            { .x = -1, .y = 1 },
-            { .x = 1, .y = -1 },
-            { .x = 1, .y = 1 }
-        };
-        struct Point positions[4] = {
-            {pos.x + moveVecs[0].x, .y = pos.y + moveVecs[0].y},
-            {pos.x + moveVecs[1].x, .y = pos.y + moveVecs[1].y},
-            {pos.x + moveVecs[2].x, .y = pos.y + moveVecs[2].y},
-            {pos.x + moveVecs[3].x, .y = pos.y + moveVecs[3].y}
-        };
-        while (index < 4) {
-            while (1) {
-                if (!validIndex(gameboard, positions[index].x, positions[index].y)) {
-                    break;
+int boardSquareFromNumber(int number) {
+    if (number < 1 || number > CHECKERS_BOARD_SIZE * CHECKERS_HALF_SIZE) {
+        return -1;
+    }
+    int index = number - 1;
+    int y = index / CHECKERS_HALF_SIZE;
+    int k = index % CHECKERS_HALF_SIZE;
+    return squareIndex(y % 2 == 0 ? k * 2 + 1 : k * 2, y);
+}
+
+int boardNumberFromSquare(int square) {
+    struct Point pos = squarePoint(square);
+    return pos.y * CHECKERS_HALF_SIZE + pos.x / 2 + 1;
+}
+
+/* pieces[kind] are bitboards in struct Board layout; overlapping or off-board bits are rejected */
+int boardSetPieces(struct Board* gameboard, const uint64_t pieces[4], int sideToMove) {
+    if (!gameboard || !pieces) {
+        return 0;
+    }
+    uint64_t seen = 0;
+    for (int kind = 0; kind < 4; kind++) {
+        if ((pieces[kind] & ~CHECKERS_BOARD_MASK) || (pieces[kind] & seen)) {
+            return 0;
+        }
+        seen |= pieces[kind];
+    }
+    clearBoard(gameboard);
+    for (int kind = 0; kind < 4; kind++) {
+        uint64_t bits = pieces[kind];
+        while (bits) {
+            putPiece(gameboard, kind, lowestSquare(bits));
+            bits &= bits - 1;
+        }
+    }
+    gameboard->remainingLightPieces = __builtin_popcountll(pieces[PIECE_LIGHT_MAN] | pieces[PIECE_LIGHT_KING]);
+    gameboard->remainingDarkPieces = __builtin_popcountll(pieces[PIECE_DARK_MAN] | pieces[PIECE_DARK_KING]);
+    setSideToMove(gameboard, sideToMove == CHECKERS_PLAYER_TWO ? CHECKERS_PLAYER_TWO : CHECKERS_PLAYER_ONE);
+    CHECK_HASH(gameboard);
+    return 1;
+}
+
+int boardLoadFen(struct Board* gameboard, const char* fen) {
+    if (!gameboard || !fen) {
+        return 0;
+    }
+    boardInit(gameboard);
+    for (int kind = 0; kind < 4; kind++) {
+        uint64_t bits = gameboard->pieces[kind];
+        while (bits) {
+            removePiece(gameboard, kind, lowestSquare(bits));
+            bits &= bits - 1;
+        }
+    }
+    gameboard->remainingLightPieces = 0;
+    gameboard->remainingDarkPieces = 0;
+
+    while (*fen == ' ') {
+        fen++;
+    }
+    if (*fen == 'B' || *fen == 'b') {
+        setSideToMove(gameboard, CHECKERS_PLAYER_TWO);
+    } else if (*fen != 'W' && *fen != 'w') {
+        return 0;
+    }
+    fen++;
+
+    int player = -1;
+    while (*fen && *fen != '.') {
+        char ch = *fen;
+        if (ch == ':') {
+            fen++;
+            if (*fen == 'W' || *fen == 'w') {
+                player = CHECKERS_PLAYER_ONE;
+            } else if (*fen == 'B' || *fen == 'b') {
+                player = CHECKERS_PLAYER_TWO;
+            } else {
+                return 0;
+            }
+            fen++;
+        } else if (ch == ',' || ch == ' ') {
+            fen++;
+        } else if (player >= 0 && (ch == 'K' || ch == 'k' || (ch >= '0' && ch <= '9'))) {
+            int kind = player * 2;
+            if (ch == 'K' || ch == 'k') {
+                kind += 1;
+                fen++;
+            }
+            char* end;
+            long first = strtol(fen, &end, 10);
+            long last = first;
+            if (end == fen) {
+                return 0;
+            }
+            fen = end;
+            if (*fen == '-') {
+                last = strtol(fen + 1, &end, 10);
+                if (end == fen + 1) {
+                    return 0;
+                }
+                fen = end;
+            }
+            for (long number = first; number <= last; number++) {
+                if (number < 1 || number > CHECKERS_BOARD_SIZE * CHECKERS_HALF_SIZE) {
+                    return 0;
                 }
-                if (gameboard->board[positions[index].y][positions[index].x] == enemyMan || gameboard->board[positions[index].y][positions[index].x] == enemyKing) {
-                    if (canCapture(gameboard, enemyMan, enemyKing, positions[index], moveVecs[index])) {
-                        return 1;
-                    } else {
-                        break;
-                    }
-                } else if (gameboard->board[positions[index].y][positions[index].x] != gameboard->blank) {
-                    break;
+                int square = boardSquareFromNumber(number);
+                if (!(gameboard->empty & (1ULL << square))) {
+                    return 0;
+                }
+                putPiece(gameboard, kind, square);
+                if (player == CHECKERS_PLAYER_ONE) {
+                    gameboard->remainingLightPieces += 1;
+                } else {
+                    gameboard->remainingDarkPieces += 1;
                 }
-                positions[index].x += moveVecs[index].x;
-                positions[index].y += moveVecs[index].y;
             }
-            index++;
+        } else {
+            return 0;
         }
-        return 0;
-    } else if (playerPiece == playerMan) {
-        char p[4] = {
-            validIndex(gameboard, pos.x - 1, pos.y - 1) ? gameboard->board[pos.y - 1][pos.x - 1] : gameboard->blank,
-            validIndex(gameboard, pos.x + 1, pos.y - 1) ? gameboard->board[pos.y - 1][pos.x + 1] : gameboard->blank,
-            validIndex(gameboard, pos.x + 1, pos.y + 1) ? gameboard->board[pos.y + 1][pos.x + 1] : gameboard->blank,
-            validIndex(gameboard, pos.x - 1, pos.y + 1) ? gameboard->board[pos.y + 1][pos.x - 1] : gameboard->blank
-        };
-        char c[4] = {
-            validIndex(gameboard, pos.x - 2, pos.y - 2) && gameboard->board[pos.y - 2][pos.x - 2] == gameboard->blank ? gameboard->blank : '\0',
-            validIndex(gameboard, pos.x + 2, pos.y - 2) && gameboard->board[pos.y - 2][pos.x + 2] == gameboard->blank ? gameboard->blank : '\0',
-            validIndex(gameboard, pos.x + 2, pos.y + 2) && gameboard->board[pos.y + 2][pos.x + 2] == gameboard->blank ? gameboard->blank : '\0',
-            validIndex(gameboard, pos.x - 2, pos.y + 2) && gameboard->board[pos.y + 2][pos.x - 2] == gameboard->blank ? gameboard->blank : '\0'
-        };
-        return (
-            ((p[0] == enemyMan || p[0] == enemyKing) && c[0]) ||
-            ((p[1] == enemyMan || p[1] == enemyKing) && c[1]) ||
-            ((p[2] == enemyMan || p[2] == enemyKing) && c[2]) ||
-            ((p[3] == enemyMan || p[3] == enemyKing) && c[3])
-        );
-    } else {
-        return 0;
     }
+    CHECK_HASH(gameboard);
+    return 1;
 }
 
-int boardCheckIfPlayerCanCapture(struct Board* gameboard, int player) {
-    if (!gameboard || (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO)) {
+int boardWriteFen(struct Board* gameboard, char* out, size_t out_size) {
+    if (!gameboard || !out || out_size == 0) {
         return 0;
     }
-    int should = 0;
-    for (unsigned int y = 0; y < gameboard->boardSize && !should; y++) {
-        for (unsigned int x = 0; x < gameboard->boardSize && !should; x++) {
-            should = boardCheckIfPieceCanCapture(gameboard, player, (struct Point){ .x = x, .y = y });
+    size_t len = 0;
+    int written = snprintf(out, out_size, "%c", gameboard->sideToMove == CHECKERS_PLAYER_ONE ? 'W' : 'B');
+    for (int player = CHECKERS_PLAYER_ONE; player <= CHECKERS_PLAYER_TWO && written >= 0; player++) {
+        len += written;
+        if (len >= out_size) {
+            return 0;
         }
+        written = snprintf(out + len, out_size - len, ":%c", player == CHECKERS_PLAYER_ONE ? 'W' : 'B');
+        uint64_t bits = playerPieces(gameboard, player);
+        const char* sep = "";
+        while (bits && written >= 0) {
+            len += written;
+            if (len >= out_size) {
+                return 0;
+            }
+            int square = lowestSquare(bits);
+            bits &= bits - 1;
+            int king = pieceAt(gameboard, square) & 1;
+            written = snprintf(out + len, out_size - len, "%s%s%d", sep, king ? "K" : "", boardNumberFromSquare(square));
+            sep = ",";
+        }
+    }
+    if (written < 0 || len + written >= out_size) {
+        return 0;
     }
-    return should;
+    return 1;
+}
+
+int boardPieceAt(struct Board* gameboard, int square) {
+    if (!gameboard || square < 0 || square >= CHECKERS_SQUARE_BITS) {
+        return PIECE_NONE;
+    }
+    return pieceAt(gameboard, square);
 }
 
 void boardPrint(struct Board* gameboard) {
@@ -461,9 +980,14 @@ int checkersInit(struct Checkers* game, int forceCapture, int enableAi) {
     return 1;
 }
 
-// TODO - Handle CSTATE_END_DRAW
 int checkersMakeMove(struct Checkers* game, struct Point from, struct Point to) {
-    if (!game || !game->flags.run) {
+    struct CheckersUndo undo;
+    return checkersMakeMoveUndoable(game, from, to, &undo);
+}
+
+// TODO - Handle CSTATE_END_DRAW
+int checkersMakeMoveUndoable(struct Checkers* game, struct Point from, struct Point to, struct CheckersUndo* undo) {
+    if (!game || !game->flags.run || !undo) {
         return 0;
     }
 
@@ -485,7 +1009,11 @@ int checkersMakeMove(struct Checkers* game, struct Point from, struct Point to)
         return 0;
     }
 
-    int status = boardTryMoveOrCapture(&game->checkersBoard, player, from, to);
+    undo->turnsTotal = game->turnsTotal;
+    undo->state = game->state;
+    undo->run = game->flags.run;
+
+    int status = movePiece(&game->checkersBoard, player, from, to, &undo->boardUndo);
     if (status == CHECKERS_CAPTURE_SUCCESS) {
         if (boardRemainingPiecesPlayer(&game->checkersBoard, enemy) == 0) {
             game->state = nextStateWin;
@@ -497,16 +1025,33 @@ int checkersMakeMove(struct Checkers* game, struct Point from, struct Point to)
         } else {
             game->turnsTotal += 1;
             game->state = nextStatePlayer;
+            setSideToMove(&game->checkersBoard, enemy);
             boardTryTurnKing(&game->checkersBoard, to);
         }
     } else if (status == CHECKERS_MOVE_SUCCESS) {
         game->turnsTotal += 1;
         game->state = nextStatePlayer;
+        setSideToMove(&game->checkersBoard, enemy);
         boardTryTurnKing(&game->checkersBoard, to);
     }
+    if (status == CHECKERS_CAPTURE_SUCCESS || status == CHECKERS_MOVE_SUCCESS) {
+        undo->boardUndo.promoted = pieceAt(&game->checkersBoard, undo->boardUndo.move.to) != undo->boardUndo.piece;
+    }
     return status;
 }
 
+void checkersUndoMove(struct Checkers* game, const struct CheckersUndo* undo) {
+    if (!game || !undo) {
+        return;
+    }
+    unapplyMove(&game->checkersBoard, &undo->boardUndo);
+    setSideToMove(&game->checkersBoard, undo->state == CSTATE_P2_TURN ? CHECKERS_PLAYER_TWO : CHECKERS_PLAYER_ONE);
+    CHECK_HASH(&game->checkersBoard);
+    game->turnsTotal = undo->turnsTotal;
+    game->state = undo->state;
+    game->flags.run = undo->run;
+}
+
 int checkersGetCurrentPlayer(struct Checkers* game) {
     if (!game || !game->flags.run) {
         return -1;
@@ -551,6 +1096,34 @@ struct Moves* checkersGetAvailableMovesForPlayer(struct Checkers* game, size_t*
     return boardGetAvailableMovesForPlayer(&game->checkersBoard, checkersGetCurrentPlayer(game), game->flags.forceCapture, out_size);
 }
 
+size_t checkersGenerateMoves(struct Checkers* game, struct MoveList* list) {
+    if (!list) {
+        return 0;
+    }
+    if (!game || !game->flags.run) {
+        list->size = 0;
+        return 0;
+    }
+    return boardGenerateMoves(&game->checkersBoard, checkersGetCurrentPlayer(game), game->flags.forceCapture, list);
+}
+
+int checkersFindMove(struct MoveList* list, struct Point from, struct Point to) {
+    if (!list) {
+        return -1;
+    }
+    int fromSquare = boardSquareFromPoint(from);
+    int toSquare = boardSquareFromPoint(to);
+    if (fromSquare < 0 || toSquare < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < list->size; i++) {
+        if (list->moves[i].from == fromSquare && list->moves[i].to == toSquare) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void checkersDestroyMovesList(struct Moves* moves, size_t moves_size) {
     if (moves) {
         for (size_t i = 0; i < moves_size; i++) {
@@ -595,114 +1168,77 @@ void checkersPrint(struct Checkers* game) {
 
 // ----
 
-static int movePiece(struct Board* gameboard, int player, struct Point piecePos, struct Point newPos) {
-    if (!validIndex(gameboard, newPos.x, newPos.y) || !validIndex(gameboard, piecePos.x, piecePos.y)) {
+
+static int movePiece(struct Board* gameboard, int player, struct Point piecePos, struct Point newPos, struct MoveUndo* undo) {
+    TRACE_SCOPE("movePiece");
+    if (!validIndex(newPos.x, newPos.y) || !validIndex(piecePos.x, piecePos.y)) {
         return CHECKERS_INVALID_MOVE;
     }
-    char playerMan = 0, playerKing = 0;
-    char enemyMan = 0, enemyKing = 0;
-
-    int illegalY = 0;
-    if (player == CHECKERS_PLAYER_ONE) {
-        playerMan = gameboard->pieceLightMan;
-        playerKing = gameboard->pieceLightKing;
-
-        enemyMan = gameboard->pieceDarkMan;
-        enemyKing = gameboard->pieceDarkKing;
-
-        illegalY = 1;
-    } else if (player == CHECKERS_PLAYER_TWO) {
-        playerMan = gameboard->pieceDarkMan;
-        playerKing = gameboard->pieceDarkKing;
-
-        enemyMan = gameboard->pieceLightMan;
-        enemyKing = gameboard->pieceLightKing;
-        illegalY = -1;
-    } else {
+    if (player != CHECKERS_PLAYER_ONE && player != CHECKERS_PLAYER_TWO) {
         return CHECKERS_INVALID_PLAYER;
     }
+    int playerMan = player * 2;
+    int playerKing = playerMan + 1;
+    int illegalDir = player == CHECKERS_PLAYER_ONE ? 1 : 0; /* the "down" pair of directions for light men */
+
+    int from = squareIndex(piecePos.x, piecePos.y);
+    int kind = from < 0 ? PIECE_NONE : pieceAt(gameboard, from);
+    if (kind != playerMan && kind != playerKing) {
+        return CHECKERS_NOT_A_PIECE;
+    }
 
     int x = newPos.x - piecePos.x;
     int y = newPos.y - piecePos.y;
 
     int absX = abs(x);
     int absY = abs(y);
+    if (absX != absY || absX == 0) {
+        return CHECKERS_INVALID_MOVE;
+    }
 
-    char capturePiece = 0;
-    struct Point moveVec = {
-        .x = x > 0 ? 1 : -1,
-        .y = y > 0 ? 1 : -1
-    };
+    int dir = (y > 0) * 2 + (x > 0);
+    int to = squareIndex(newPos.x, newPos.y);
+    uint64_t own = playerPieces(gameboard, player);
+    uint64_t enemies = playerPieces(gameboard, !player);
 
-    if (gameboard->board[piecePos.y][piecePos.x] == playerKing) {
-        if (absX != absY) {
-            return CHECKERS_INVALID_MOVE;
-        }
-        int enemyPieceCount = 0;
-        struct Point enemyPiece = { -1, -1 };
-        struct Point testPos = piecePos;
-
-        while (testPos.x + moveVec.x != newPos.x + moveVec.x && testPos.y + moveVec.y != newPos.y + moveVec.y) {
-            capturePiece = gameboard->board[testPos.y + moveVec.y][testPos.x + moveVec.x];
-            if (capturePiece == playerMan || capturePiece == playerKing) {
+    int captured = -1;
+    if (kind == playerKing) {
+        uint64_t bit = 1ULL << from;
+        for (int i = 0; i < absX; i++) {
+            bit = shiftBits(bit, dirShift[dir]);
+            if (bit & own) {
                 return CHECKERS_MOVE_FAIL;
             }
-            if (capturePiece == enemyMan || capturePiece == enemyKing) {
-                capturePiece = gameboard->board[testPos.y + moveVec.y][testPos.x + newPos.y];
-                if (enemyPieceCount >= 1) {
+            if (bit & enemies) {
+                if (captured >= 0) {
                     return CHECKERS_MOVE_FAIL;
                 }
-                enemyPieceCount++;
-                enemyPiece.x = testPos.x + moveVec.x;
-                enemyPiece.y = testPos.y + moveVec.y;
+                captured = lowestSquare(bit);
             }
-            testPos.x += moveVec.x;
-            testPos.y += moveVec.y;
         }
-
-        if (enemyPiece.x == testPos.x && enemyPiece.y == testPos.y) {
+        if (captured == to) {
             return CHECKERS_MOVE_FAIL;
         }
-        int capture = 0;
-        if (enemyPiece.x != -1 && enemyPiece.y != -1) {
-            if (player == CHECKERS_PLAYER_ONE) {
-                gameboard->remainingDarkPieces -= 1;
-            } else {
-                gameboard->remainingLightPieces -= 1;
+    } else {
+        uint64_t step = shiftBits(1ULL << from, dirShift[dir]);
+        if (absX == 2) {
+            if (!(step & enemies)) {
+                return CHECKERS_INVALID_MOVE;
             }
-            capture = 1;
-            gameboard->board[enemyPiece.y][enemyPiece.x] = gameboard->blank;
-        }
-
-        gameboard->board[piecePos.y][piecePos.x] = gameboard->blank;
-        gameboard->board[newPos.y][newPos.x] = playerKing;
-        return capture ? CHECKERS_CAPTURE_SUCCESS : CHECKERS_MOVE_SUCCESS;
-    } else if (gameboard->board[piecePos.y][piecePos.x] == playerMan) {
-        capturePiece = gameboard->board[piecePos.y + moveVec.y][piecePos.x + moveVec.x];
-        
-        if (absX != 1 || absY != 1) {
-            if (absX == 2 && absY == 2 && (capturePiece == enemyMan || capturePiece == enemyKing)) {
-                if (player == CHECKERS_PLAYER_ONE) {
-                    gameboard->remainingDarkPieces -= 1;
-                } else {
-                    gameboard->remainingLightPieces -= 1;
-                }
-                gameboard->board[piecePos.y + moveVec.y][piecePos.x + moveVec.x] = gameboard->blank;
-                gameboard->board[piecePos.y][piecePos.x] = gameboard->blank;
-                gameboard->board[newPos.y][newPos.x] = playerMan;
-                return CHECKERS_CAPTURE_SUCCESS;
+            if (!(gameboard->empty & (1ULL << to))) {
+                return CHECKERS_MOVE_FAIL;
             }
+            captured = lowestSquare(step);
+        } else if (absX != 1) {
             return CHECKERS_INVALID_MOVE;
+        } else if (!(step & gameboard->empty) || (dir >> 1) == illegalDir) {
+            return CHECKERS_MOVE_FAIL;
         }
-
-        if (capturePiece != gameboard->blank || moveVec.y == illegalY) {
-            return CHECKERS_MOVE_FAIL;   
-        }
-
-        gameboard->board[piecePos.y][piecePos.x] = gameboard->blank;
-        gameboard->board[newPos.y][newPos.x] = playerMan;
-        return CHECKERS_MOVE_SUCCESS;
-    } else {
-        return CHECKERS_NOT_A_PIECE;
     }
-}
\ No newline at end of file
+
+    struct MoveUndo scratch;
+    struct Move move = { .from = from, .to = to, .captured = captured >= 0 ? captured : CHECKERS_NO_SQUARE };
+    applyMove(gameboard, move, undo ? undo : &scratch);
+    CHECK_HASH(gameboard);
+    return captured >= 0 ? CHECKERS_CAPTURE_SUCCESS : CHECKERS_MOVE_SUCCESS;
+}
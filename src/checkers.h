@@ -4,9 +4,32 @@
 #define CHECKERS_PLAYER_ONE          0
 #define CHECKERS_PLAYER_TWO          1
 
+/* 10 for international draughts, 8 for the same rules on the small board; set by 'make BOARD=8' */
+#ifndef CHECKERS_BOARD_SIZE
 #define CHECKERS_BOARD_SIZE         10
+#endif
+#if CHECKERS_BOARD_SIZE != 8 && CHECKERS_BOARD_SIZE != 10
+#error "CHECKERS_BOARD_SIZE must be 8 or 10"
+#endif
 #define CHECKERS_PIECES_AMOUNT      (CHECKERS_BOARD_SIZE / 2) * ((CHECKERS_BOARD_SIZE - 2) / 2)
 
+/**
+ * Bitboard layout: the playable (dark) squares are numbered row by row,
+ * CHECKERS_BOARD_SIZE / 2 per row, and every pair of rows is followed by
+ * one unused "ghost" bit. With that padding, a diagonal step is always a
+ * shift by CHECKERS_HALF_SIZE or CHECKERS_HALF_SIZE + 1, and a step off the
+ * left or right edge lands on a ghost bit, which CHECKERS_BOARD_MASK removes.
+ */
+#define CHECKERS_HALF_SIZE          (CHECKERS_BOARD_SIZE / 2)
+#define CHECKERS_ROW_PAIR_BITS      (CHECKERS_BOARD_SIZE + 1)
+#define CHECKERS_SQUARE_BITS        (CHECKERS_HALF_SIZE * CHECKERS_ROW_PAIR_BITS)
+#define CHECKERS_NO_SQUARE          0xFF
+#define CHECKERS_MAX_MOVES          256
+#define CHECKERS_EVAL_SCALE         100 /* evaluation units per point, see struct Board eval */
+#define CHECKERS_BOARD_MASK         ((((1ULL << CHECKERS_SQUARE_BITS) - 1) / ((1ULL << CHECKERS_ROW_PAIR_BITS) - 1)) * ((1ULL << CHECKERS_BOARD_SIZE) - 1))
+
+_Static_assert(CHECKERS_SQUARE_BITS <= 64, "the playable squares and ghost bits must fit a uint64_t");
+
 #define CHECKERS_CAPTURE_SUCCESS     2
 #define CHECKERS_MOVE_SUCCESS        1
 #define CHECKERS_NULL_BOARD         -1
@@ -28,8 +51,42 @@ struct Moves {
     size_t to_size;
 };
 
+/* squares are bitboard indices, see boardSquareFromPoint */
+struct Move {
+    uint8_t from, to;
+    uint8_t captured; /* square of the jumped piece, CHECKERS_NO_SQUARE for a plain move */
+};
+
+/* everything boardUnmakeMove needs to restore the position exactly */
+struct MoveUndo {
+    struct Move move;
+    uint8_t piece;          /* enum PieceType of the moved piece, before any promotion */
+    uint8_t capturedPiece;  /* enum PieceType on move.captured, PIECE_NONE for a plain move */
+    uint8_t promoted;
+    uint8_t chained;        /* the side to move was kept for the capturing piece to go on */
+};
+
+/* fixed-capacity move buffer, meant to live on the caller's stack */
+struct MoveList {
+    size_t size;
+    struct Move moves[CHECKERS_MAX_MOVES];
+};
+
+enum PieceType {
+    PIECE_LIGHT_MAN,
+    PIECE_LIGHT_KING,
+    PIECE_DARK_MAN,
+    PIECE_DARK_KING,
+    PIECE_NONE
+};
+
 struct Board {
-    uint8_t boardSize;
+    uint64_t pieces[4]; /* indexed by enum PieceType */
+    uint64_t empty;
+    uint64_t hash;          /* Zobrist key of the pieces and sideToMove, kept up to date on every change */
+    int32_t eval;           /* sum of the piece-square scores, dark positive, kept up to date like hash */
+    uint8_t sideToMove;
+    uint8_t boardSize;      /* always CHECKERS_BOARD_SIZE, the geometry is fixed at compile time */
     uint8_t remainingLightPieces;
     uint8_t remainingDarkPieces;
     char pieceLightMan;
@@ -37,7 +94,7 @@ struct Board {
     char pieceDarkMan;
     char pieceDarkKing;
     char blank;
-    char board[CHECKERS_BOARD_SIZE][CHECKERS_BOARD_SIZE];
+    char board[CHECKERS_BOARD_SIZE][CHECKERS_BOARD_SIZE]; /* derived from the bitboards, kept for display */
 };
 
 enum GameState {
@@ -59,26 +116,65 @@ struct Checkers {
     struct Board checkersBoard;
 };
 
+struct CheckersUndo {
+    struct MoveUndo boardUndo;
+    int turnsTotal;
+    enum GameState state;
+    uint8_t run;
+};
+
 int boardInit(struct Board* gameboard);
 int boardTryMoveOrCapture(struct Board* gameboard, int player, struct Point piecePos, struct Point newPos);
+void boardMakeMove(struct Board* gameboard, struct Move move, struct MoveUndo* undo); /* trusts move, promotes men reaching the last row */
+/**
+ * Plays a move the way checkersMakeMove does: with forced captures, a capture the
+ * same piece can go on with keeps the side to move and leaves a man uncrowned
+ * until its last hop. boardGenerateChainMoves gives the hops that may follow.
+ */
+void boardMakeChainedMove(struct Board* gameboard, struct Move move, int forceCapture, struct MoveUndo* undo);
+void boardUnmakeMove(struct Board* gameboard, const struct MoveUndo* undo);
 void boardTryTurnKing(struct Board* gameboard, struct Point piecePos);
 int boardRemainingPiecesTotal(struct Board* gameboard);
 int boardRemainingPiecesPlayer(struct Board* gameboard, int player);
 int boardGetAvailableMovesForPiece(struct Board* gameboard, struct Point piecePos, struct Point** out, int includeBackwardsCaptures);
 struct Moves* boardGetAvailableMovesForPlayer(struct Board* gameboard, int player, int forceCapture, size_t* out_size);
+size_t boardGenerateMoves(struct Board* gameboard, int player, int forceCapture, struct MoveList* list); /* only captures if forceCapture is set and one exists */
+size_t boardGenerateCaptures(struct Board* gameboard, int player, int forceCapture, struct MoveList* list); /* the captures boardGenerateMoves would offer, quiet moves never */
+size_t boardGeneratePieceMoves(struct Board* gameboard, struct Point piecePos, int includeBackwardsCaptures, struct MoveList* list);
+size_t boardGenerateChainMoves(struct Board* gameboard, int square, int forceCapture, struct MoveList* list); /* the captures the piece on square can go on with */
 int boardCheckIfPieceCanCapture(struct Board* gameboard, int player, struct Point pos);
 int boardCheckIfPlayerCanCapture(struct Board* gameboard, int player);
 void boardPrint(struct Board* gameboard);
+int boardSquareFromPoint(struct Point pos); /* returns -1 if pos is not a playable square */
+struct Point boardPointFromSquare(int square);
+int boardPieceAt(struct Board* gameboard, int square); /* returns an enum PieceType */
+uint64_t boardComputeHash(struct Board* gameboard); /* full recompute, gameboard->hash is the incremental one */
+int32_t boardComputeEval(struct Board* gameboard); /* full recompute, gameboard->eval is the incremental one */
+int32_t boardSquareScore(int kind, int square); /* material plus position of one piece, in CHECKERS_EVAL_SCALE units, dark positive */
+/**
+ * Positions as PDN FEN strings, e.g. "W:W31-50:B1-20": side to move, then the
+ * light (W) and dark (B) pieces by square number, 1 being the top left playable
+ * square, with a K prefix for kings and ranges allowed.
+ */
+int boardLoadFen(struct Board* gameboard, const char* fen);
+int boardSquareFromNumber(int number); /* PDN square number to bitboard square, -1 if out of range */
+int boardNumberFromSquare(int square);
+int boardSetPieces(struct Board* gameboard, const uint64_t pieces[4], int sideToMove);
+int boardWriteFen(struct Board* gameboard, char* out, size_t out_size);
 
 // ---
 
 int checkersInit(struct Checkers* game, int forceCapture, int enableAi);
 int checkersMakeMove(struct Checkers* game, struct Point from, struct Point to);
+int checkersMakeMoveUndoable(struct Checkers* game, struct Point from, struct Point to, struct CheckersUndo* undo); /* undo is only filled in on success */
+void checkersUndoMove(struct Checkers* game, const struct CheckersUndo* undo);
 int checkersGetCurrentPlayer(struct Checkers* game);
 int checkersGetWinner(struct Checkers* game);
 // int checkersGetClosestEnemies(struct Checkers* game, struct Point playerPos, struct Point* enemiesPos); /* receives output buffer and returns size */
 int checkersPlayerShallCapture(struct Checkers* game);
 struct Moves* checkersGetAvailableMovesForPlayer(struct Checkers* game, size_t* out_size);
+size_t checkersGenerateMoves(struct Checkers* game, struct MoveList* list);
+int checkersFindMove(struct MoveList* list, struct Point from, struct Point to); /* returns the index of the move or -1 */
 void checkersDestroyMovesList(struct Moves* moves, size_t moves_size);
 void checkersPrint(struct Checkers* game);
 
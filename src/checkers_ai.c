@@ -1,9 +1,14 @@
 #include "checkers_ai.h"
 #include "checkers.h"
-#include "external/rprand.h"
+#include "checkers_tt.h"
+#include "checkers_score.h"
+#include "checkers_tb.h"
+#include "checkers_book.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
-#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <time.h>
 
@@ -18,24 +23,87 @@
 #include <synchapi.h>
 
 typedef uintptr_t aithread;
-typedef HANDLE aimutex;
+typedef CRITICAL_SECTION aimutex;
+typedef CONDITION_VARIABLE aicond;
+
+#define THREAD_RETURN unsigned __stdcall
 
 #else
 
 #include <pthread.h>
 
 typedef pthread_mutex_t aimutex;
+typedef pthread_cond_t aicond;
 typedef pthread_t aithread;
 
+#define THREAD_RETURN void*
+
 #endif
 
+/* last, so its allocator macros stay out of the system headers */
+#include "checkers_trace.h"
+
+/**
+ * One worker thread lives as long as the Ai and sleeps on queue.changed until
+ * a position is requested. Everything in queue is guarded by queue.mutex, which
+ * is never held during a search; stop and the deadlines are polled by the search
+ * itself, so a ponder hit can start the clock of a search that is already running.
+ */
 struct Ai {
     struct {
         struct AiMoves content;
+        uint64_t contentKey;    /* position the content was searched for */
+        struct Board board;     /* requested position */
+        int forceCapture;
+        int pending;
+        int ponder;             /* the pending request has no clock until the opponent moves */
+        uint64_t ponderKey;     /* opponent's position pondered on since the last cancel */
+        int busy;               /* a search is running, on the worker or in GenMovesSync */
+        int busyPonder;
+        uint64_t busyKey;
+        uint64_t busyStart;
+        struct AiLine pv;       /* of the last iteration the main thread completed */
+        int quit;
         aimutex mutex;
+        aicond changed;
     } queue;
+    atomic_int stop;
+    _Atomic uint64_t deadline;      /* milliseconds on the monotonic clock, 0 for none */
+    _Atomic uint64_t softDeadline;  /* no new iteration is started after it */
     aithread tid;
     struct Checkers* checkers;
+    struct TranspositionTable* tt;
+    struct Tablebase* tb;
+    struct Book* book;
+    struct OrderTables* order;  /* one per search thread, aged at the start of every search */
+    struct {
+        struct SearchCounters* threads; /* one per search thread, cleared at the start of every search */
+        _Atomic uint64_t start;     /* milliseconds on the monotonic clock, 0 before the first search */
+        _Atomic uint64_t end;       /* 0 while the search runs */
+        atomic_int depth;
+    } stats;
+    uint64_t random;    /* xorshift state of the tie and book picks, per Ai so that several can play at once */
+    struct AiConfig config;
+};
+
+#define KILLER_PLIES    128
+#define HISTORY_MAX     400000  /* the table is halved when an entry passes it, below ORDER_KILLER */
+
+/* what one search thread learns about quiet moves, kept across moves */
+struct OrderTables {
+    struct Move killers[KILLER_PLIES][2];   /* the last two quiet moves that cut off at each ply */
+    int32_t history[2][CHECKERS_SQUARE_BITS][CHECKERS_SQUARE_BITS]; /* cutoffs by side, from and to, weighted by depth */
+};
+
+/* one search thread's counters as checkersAiGetStats sees them, copied from its Search now and then */
+struct SearchCounters {
+    _Atomic uint64_t nodes;
+    _Atomic uint64_t expanded;
+    _Atomic uint64_t cutoffs;
+    _Atomic uint64_t firstCutoffs;
+    _Atomic uint64_t probes;
+    _Atomic uint64_t hits;
+    atomic_int selDepth;
 };
 
 static struct AiMoves invalidMove = {
@@ -45,17 +113,38 @@ static struct AiMoves invalidMove = {
 };
 
 static inline int createThread(struct Ai* ai);
+static inline void joinThread(struct Ai* ai);
 
 static inline int createMutex(struct Ai* ai);
 static inline int destroyMutex(struct Ai* ai);
-static inline int tryLockMutex(struct Ai* ai);
 static inline int lockMutex(struct Ai* ai);
 static inline int unlockMutex(struct Ai* ai);
+static inline int waitChanged(struct Ai* ai);
+static inline int broadcastChanged(struct Ai* ai);
 
-static struct AiMoves minimax(struct Ai* ai);
+static struct AiMoves minimax(struct Ai* ai, struct Board* board, int forceCapture);
+static void cancelLocked(struct Ai* ai);
+static void startClockLocked(struct Ai* ai, int ponder, uint64_t start);
+static inline uint64_t clockMs(void);
+static inline int sameMove(struct Move a, struct Move b);
+static inline uint64_t nodeKey(struct Board* gameboard, int chain);
 
 struct Ai* checkersAiCreate(struct Checkers* gameboard) {
-    if (!gameboard) {
+    struct AiConfig config = {
+        .ttMegabytes = AI_DEFAULT_TT_MEGABYTES,
+        .maxDepth = AI_MAX_DEPTH,
+        .timeMs = AI_DEFAULT_TIME_MS,
+        .nodeLimit = 0,
+        .threads = 1,
+        .ponder = 1,
+        .tablebasePath = AI_DEFAULT_TABLEBASE_PATH,
+        .bookPath = AI_DEFAULT_BOOK_PATH
+    };
+    return checkersAiCreateEx(gameboard, &config);
+}
+
+struct Ai* checkersAiCreateEx(struct Checkers* gameboard, const struct AiConfig* config) {
+    if (!gameboard || !config) {
         return NULL;
     }
     struct Ai* ai = calloc(1, sizeof(struct Ai));
@@ -67,54 +156,264 @@ struct Ai* checkersAiCreate(struct Checkers* gameboard) {
         free(ai);
         return NULL;
     }
-    ai->tid = 0;
+    ai->tt = ttCreate(config->ttMegabytes);
+    if (!ai->tt) {
+        destroyMutex(ai);
+        free(ai);
+        return NULL;
+    }
     ai->checkers = gameboard;
+    ai->config = *config;
+    if (ai->config.threads <= 0) {
+        ai->config.threads = 1;
+    } else if (ai->config.threads > AI_MAX_THREADS) {
+        ai->config.threads = AI_MAX_THREADS;
+    }
+    ai->order = calloc(ai->config.threads, sizeof(struct OrderTables));
+    ai->stats.threads = calloc(ai->config.threads, sizeof(struct SearchCounters));
+    if (!ai->order || !ai->stats.threads) {
+        free(ai->order);
+        free(ai->stats.threads);
+        ttDestroy(ai->tt);
+        destroyMutex(ai);
+        free(ai);
+        return NULL;
+    }
+    ai->tb = tbOpen(config->tablebasePath, gameboard->flags.forceCapture);
+    ai->book = bookOpen(config->bookPath, gameboard->flags.forceCapture);
+    // seeded once here rather than on every pick, which made picks within a second repeat,
+    // and with the address too, so AIs created in the same second differ
+    ai->random = ((uint64_t) time(NULL) << 32 ^ (uint64_t) (uintptr_t) ai) * 0x9E3779B97F4A7C15ULL | 1;
+    if (ai->config.maxDepth <= 0 || ai->config.maxDepth > AI_MAX_DEPTH) {
+        ai->config.maxDepth = AI_MAX_DEPTH;
+    }
+    if (!createThread(ai)) {
+        bookClose(ai->book);
+        tbClose(ai->tb);
+        free(ai->order);
+        free(ai->stats.threads);
+        ttDestroy(ai->tt);
+        destroyMutex(ai);
+        free(ai);
+        return NULL;
+    }
     return ai;
 }
 
+/**
+ * Asks the worker for a move in the current position. Calling it again for the
+ * same position is free; a different position (after a takeback, say) cancels
+ * whatever the worker was doing and starts over.
+ */
 int checkersAiGenMovesAsync(struct Ai* ai) {
-    if (ai) {
-        if (!tryLockMutex(ai)) {
-            return 1;
-        }
-        if (ai->queue.content.valid) {
-            unlockMutex(ai);
-            return 1;
-        }
-        // initialize thread and return
-        if (!createThread(ai)) {
-            unlockMutex(ai);
-            return 0;
+    if (!ai) {
+        return 0;
+    }
+    if (!ai->checkers->flags.run || ai->checkers->state != CSTATE_P2_TURN) {
+        return 1;
+    }
+    uint64_t key = ai->checkers->checkersBoard.hash;
+    lockMutex(ai);
+    if (ai->queue.busy && ai->queue.busyKey == key) {
+        // ponder hit, the search goes on with the time it has already spent counted against it
+        if (ai->queue.busyPonder) {
+            ai->queue.busyPonder = 0;
+            startClockLocked(ai, 0, ai->queue.busyStart);
         }
+    } else if (ai->queue.pending && ai->queue.board.hash == key) {
+        ai->queue.ponder = 0;
+    } else if (!ai->queue.content.valid || ai->queue.contentKey != key) {
+        cancelLocked(ai);
+        ai->queue.board = ai->checkers->checkersBoard;
+        ai->queue.forceCapture = ai->checkers->flags.forceCapture;
+        ai->queue.pending = 1;
+        ai->queue.ponder = 0;
+        broadcastChanged(ai);
+    }
+    unlockMutex(ai);
+    return 1;
+}
+
+/**
+ * Thinks on the opponent's time, meant to be called once per opponent's turn.
+ * The expected reply is taken from the table, every hop of it, and the position
+ * after it is searched without a clock; if the opponent plays it,
+ * checkersAiGenMovesAsync turns that search into the real one. Without a guess
+ * the opponent's own position is searched, which still leaves every reply in
+ * the table for when the actual move arrives.
+ */
+int checkersAiPonderAsync(struct Ai* ai) {
+    if (!ai) {
+        return 0;
+    }
+    if (!ai->config.ponder || !ai->checkers->flags.run || ai->checkers->state != CSTATE_P1_TURN) {
+        return 1;
+    }
+    uint64_t key = ai->checkers->checkersBoard.hash;
+    lockMutex(ai);
+    if (ai->queue.ponderKey == key) {
         unlockMutex(ai);
         return 1;
     }
-    return 0;
+    cancelLocked(ai);
+    struct Board board = ai->checkers->checkersBoard;
+    int forceCapture = ai->checkers->flags.forceCapture;
+    struct TtEntry entry;
+    struct MoveList moves;
+    checkersGenerateMoves(ai->checkers, &moves);
+    int chain = -1;
+    // a capture keeps the side to move until its last hop, a board mid-chain can never be hit
+    while (board.sideToMove == CHECKERS_PLAYER_ONE && ttProbe(ai->tt, nodeKey(&board, chain), &entry)) {
+        size_t i = 0;
+        while (i < moves.size && !sameMove(moves.moves[i], entry.best)) {
+            i++;
+        }
+        if (i == moves.size) {
+            break;
+        }
+        struct MoveUndo undo;
+        boardMakeChainedMove(&board, moves.moves[i], forceCapture, &undo);
+        chain = moves.moves[i].to;
+        boardGenerateChainMoves(&board, chain, forceCapture, &moves);
+    }
+    if (board.sideToMove == CHECKERS_PLAYER_ONE) {
+        board = ai->checkers->checkersBoard;
+    }
+    ai->queue.board = board;
+    ai->queue.forceCapture = forceCapture;
+    ai->queue.pending = 1;
+    ai->queue.ponder = 1;
+    ai->queue.ponderKey = key;
+    broadcastChanged(ai);
+    unlockMutex(ai);
+    return 1;
 }
 
+/* unlike the async calls, this one plays for either side, so tools can let the engine play itself */
 struct AiMoves checkersAiGenMovesSync(struct Ai* ai) {
-    return minimax(ai);
+    if (!ai || !ai->checkers->flags.run || (ai->checkers->state != CSTATE_P1_TURN && ai->checkers->state != CSTATE_P2_TURN)) {
+        return invalidMove;
+    }
+    struct Board board = ai->checkers->checkersBoard;
+    lockMutex(ai);
+    cancelLocked(ai);
+    ai->queue.busy = 1;
+    ai->queue.busyKey = board.hash;
+    atomic_store(&ai->stop, 0);
+    startClockLocked(ai, 0, clockMs());
+    unlockMutex(ai);
+
+    struct AiMoves res = minimax(ai, &board, ai->checkers->flags.forceCapture);
+
+    lockMutex(ai);
+    ai->queue.busy = 0;
+    broadcastChanged(ai);
+    unlockMutex(ai);
+    return res;
 }
 
 struct AiMoves checkersAiTryGetMoves(struct Ai* ai) {
-    if (!ai || !tryLockMutex(ai)) {
+    if (!ai) {
         return invalidMove;
     }
+    lockMutex(ai);
     struct AiMoves res = ai->queue.content;
+    if (ai->queue.contentKey != ai->checkers->checkersBoard.hash) {
+        res = invalidMove;
+    }
     ai->queue.content = invalidMove;
     unlockMutex(ai);
     return res;
 }
 
+/* stops the running search, if any, and drops pending requests and results; returns once the worker is idle */
+void checkersAiStop(struct Ai* ai) {
+    if (ai) {
+        lockMutex(ai);
+        cancelLocked(ai);
+        unlockMutex(ai);
+    }
+}
+
+/* cancels the running search, if any; the new limits hold from the next search on */
+void checkersAiSetLimits(struct Ai* ai, int maxDepth, unsigned int timeMs, uint64_t nodeLimit) {
+    if (!ai) {
+        return;
+    }
+    lockMutex(ai);
+    cancelLocked(ai);
+    ai->config.maxDepth = maxDepth <= 0 || maxDepth > AI_MAX_DEPTH ? AI_MAX_DEPTH : maxDepth;
+    ai->config.timeMs = timeMs;
+    ai->config.nodeLimit = nodeLimit;
+    unlockMutex(ai);
+}
+
+/* while a search runs, this is the line of its deepest completed iteration so far */
+int checkersAiGetPv(struct Ai* ai, struct AiLine* out) {
+    if (!ai || !out) {
+        return 0;
+    }
+    lockMutex(ai);
+    *out = ai->queue.pv;
+    unlockMutex(ai);
+    return out->size > 0;
+}
+
+/* the counters cover finished searches only */
+int checkersAiGetTtStats(struct Ai* ai, struct TtStats* out) {
+    if (!ai || !out) {
+        return 0;
+    }
+    ttGetStats(ai->tt, out);
+    return 1;
+}
+
+/* reads the counters without the mutex, so it costs the search nothing; 0 before the first search */
+int checkersAiGetStats(struct Ai* ai, struct AiStats* out) {
+    if (!ai || !out) {
+        return 0;
+    }
+    *out = (struct AiStats){0};
+    uint64_t start = atomic_load(&ai->stats.start);
+    uint64_t end = atomic_load(&ai->stats.end);
+    if (start == 0) {
+        return 0;
+    }
+    out->running = end == 0;
+    out->elapsedMs = (end ? end : clockMs()) - start;
+    out->depth = atomic_load(&ai->stats.depth);
+    out->selDepth = atomic_load_explicit(&ai->stats.threads[0].selDepth, memory_order_relaxed);
+    uint64_t expanded = 0, cutoffs = 0, firstCutoffs = 0;
+    for (int i = 0; i < ai->config.threads; i++) {
+        struct SearchCounters* counters = &ai->stats.threads[i];
+        out->nodes += atomic_load_explicit(&counters->nodes, memory_order_relaxed);
+        out->ttProbes += atomic_load_explicit(&counters->probes, memory_order_relaxed);
+        out->ttHits += atomic_load_explicit(&counters->hits, memory_order_relaxed);
+        expanded += atomic_load_explicit(&counters->expanded, memory_order_relaxed);
+        cutoffs += atomic_load_explicit(&counters->cutoffs, memory_order_relaxed);
+        firstCutoffs += atomic_load_explicit(&counters->firstCutoffs, memory_order_relaxed);
+    }
+    out->nps = out->elapsedMs ? out->nodes * 1000 / out->elapsedMs : 0;
+    out->cutoffRate = expanded ? (double) cutoffs / expanded : 0;
+    out->firstCutoffRate = cutoffs ? (double) firstCutoffs / cutoffs : 0;
+    return 1;
+}
+
 void checkersAiKill(struct Ai* ai) {
     if (ai) {
-        // wait for thread to finish if it's still running
-        #ifdef _WIN32
-        WaitForSingleObject((HANDLE) ai->tid, INFINITE);
-        #else
-        pthread_join(ai->tid, NULL);
-        #endif
+        lockMutex(ai);
+        ai->queue.quit = 1;
+        ai->queue.pending = 0;
+        atomic_store(&ai->stop, 1);
+        broadcastChanged(ai);
+        unlockMutex(ai);
+        joinThread(ai);
         destroyMutex(ai);
+        ttDestroy(ai->tt);
+        tbClose(ai->tb);
+        bookClose(ai->book);
+        free(ai->order);
+        free(ai->stats.threads);
         memset(ai, 0, sizeof(struct Ai));
         free(ai);
     }
@@ -127,205 +426,684 @@ void checkersAiKill(struct Ai* ai) {
 
 struct MinimaxRet {
     struct AiMoves move;
-    double heuristicEval;
+    aiscore heuristicEval;
+};
+
+/* a root move and the line that follows it */
+struct PvLine {
+    int size;
+    struct Move moves[AI_MAX_PV];
+};
+
+struct Search {
+    struct TranspositionTable* tt;
+    struct Tablebase* tb;   /* NULL without tablebases */
+    struct OrderTables* order;
+    struct SearchCounters* shared;  /* where checkersAiGetStats reads the counters below */
+    struct Ai* owner;   /* gets the line of every completed iteration, NULL for the helpers */
+    int forceCapture;
+    int helper;         /* 0 for the main thread */
+    uint64_t nodes;
+    uint64_t expanded;  /* nodes that searched their moves */
+    uint64_t cutoffs;
+    uint64_t firstCutoffs;
+    int selDepth;
+    uint64_t nodeLimit;
+    _Atomic uint64_t* deadline;     /* Ai's for the main thread, NULL for the helpers */
+    _Atomic uint64_t* softDeadline;
+    atomic_int* done;   /* Ai.stop for the main thread, raised by it for the helpers once it has its move */
+    int stopped;
+    int depth;          /* of the last completed iteration, 0 before the first */
+    aiscore score;      /* and its result */
+    struct TtStats counters;
+    struct Move pv[AI_MAX_PV][AI_MAX_PV];   /* triangular, pv[ply][ply..pvLength[ply]) is the best line found below ply */
+    int pvLength[AI_MAX_PV];
+};
+
+struct Helper {
+    struct Search search;
+    struct Board board;
+    int maxDepth;
+    aithread tid;
 };
 
-static double minimaxr(struct Board* gameboard, int forceCapture, int depth, int maximize);
-static double heuristics(struct Board* gameboard);
-
-static void shuffle(struct Moves* array, size_t n) {
-    rprand_set_seed(time(NULL));
-    if (n > 1) {
-        for (size_t i = 0; i < n - 1; i++) {
-            int r = rprand_get_value(0, n - 1);
-            struct Moves tmp = array[r];
-            array[r] = array[i];
-            array[i] = tmp;
+#define LIMITS_CHECK_INTERVAL   1023    /* nodes between clock reads, minus one */
+#define ASPIRATION_WINDOW       (25 * CHECKERS_EVAL_SCALE)
+#define ASPIRATION_MAX          (1600 * CHECKERS_EVAL_SCALE)   /* a wider miss falls back to the full window */
+
+#define ORDER_HASH_MOVE     1000000000
+#define ORDER_CAPTURE       1000000
+#define ORDER_KILLER        500000
+
+static aiscore negamax(struct Search* search, struct Board* gameboard, int depth, int ply, aiscore alpha, aiscore beta, int chain);
+static aiscore quiescence(struct Search* search, struct Board* gameboard, int ply, aiscore alpha, aiscore beta, int chain);
+static aiscore heuristics(struct Board* gameboard);
+
+static inline int startHelper(struct Helper* helper);
+static inline void joinHelper(struct Helper* helper);
+
+static inline uint64_t clockMs(void) {
+    #ifdef _WIN32
+    return GetTickCount64();
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    #endif
+}
+
+static inline uint64_t loadDeadline(_Atomic uint64_t* deadline) {
+    return deadline ? atomic_load_explicit(deadline, memory_order_relaxed) : 0;
+}
+
+static void shareCounters(struct Search* search) {
+    struct SearchCounters* shared = search->shared;
+    atomic_store_explicit(&shared->nodes, search->nodes, memory_order_relaxed);
+    atomic_store_explicit(&shared->expanded, search->expanded, memory_order_relaxed);
+    atomic_store_explicit(&shared->cutoffs, search->cutoffs, memory_order_relaxed);
+    atomic_store_explicit(&shared->firstCutoffs, search->firstCutoffs, memory_order_relaxed);
+    atomic_store_explicit(&shared->probes, search->counters.probes, memory_order_relaxed);
+    atomic_store_explicit(&shared->hits, search->counters.hits, memory_order_relaxed);
+    atomic_store_explicit(&shared->selDepth, search->selDepth, memory_order_relaxed);
+}
+
+/* called every LIMITS_CHECK_INTERVAL nodes, which is also when the shared counters catch up */
+static inline int outOfBudget(struct Search* search) {
+    shareCounters(search);
+    uint64_t deadline = loadDeadline(search->deadline);
+    if (atomic_load_explicit(search->done, memory_order_relaxed)
+        || (search->nodeLimit && search->nodes >= search->nodeLimit) || (deadline && clockMs() >= deadline)) {
+        search->stopped = 1;
+    }
+    return search->stopped;
+}
+
+static uint32_t nextRandom(struct Ai* ai) {
+    uint64_t x = ai->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    ai->random = x;
+    return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static size_t pickRandom(struct Ai* ai, size_t n) {
+    return n > 1 ? nextRandom(ai) % n : 0;
+}
+
+static inline int sameMove(struct Move a, struct Move b) {
+    return a.from == b.from && a.to == b.to;
+}
+
+static int32_t pieceValue(int kind) {
+    return kind == PIECE_LIGHT_KING || kind == PIECE_DARK_KING ? 100 : 20;
+}
+
+/**
+ * Hash move first, then captures by the value of the captured piece, then
+ * the two killers of this ply, then quiet moves by their history and by how
+ * much they improve the moving piece's piece-square score (a promotion counts
+ * as gaining a king).
+ */
+static void scoreMoves(struct Search* search, struct Board* gameboard, struct MoveList* moves, struct Move hashMove, int ply, int32_t* scores) {
+    struct Move* killers = ply < KILLER_PLIES ? search->order->killers[ply] : NULL;
+    int side = gameboard->sideToMove;
+    for (size_t i = 0; i < moves->size; i++) {
+        struct Move move = moves->moves[i];
+        int kind = boardPieceAt(gameboard, move.from);
+        if (sameMove(move, hashMove)) {
+            scores[i] = ORDER_HASH_MOVE;
+        } else if (move.captured != CHECKERS_NO_SQUARE) {
+            scores[i] = ORDER_CAPTURE + pieceValue(boardPieceAt(gameboard, move.captured));
+        } else if (killers && sameMove(move, killers[0])) {
+            scores[i] = ORDER_KILLER + 1;
+        } else if (killers && sameMove(move, killers[1])) {
+            scores[i] = ORDER_KILLER;
+        } else {
+            struct Point to = boardPointFromSquare(move.to);
+            int promoted = (kind == PIECE_LIGHT_MAN && to.y == 0) || (kind == PIECE_DARK_MAN && to.y == CHECKERS_BOARD_SIZE - 1);
+            int32_t gain = boardSquareScore(kind + promoted, move.to) - boardSquareScore(kind, move.from);
+            scores[i] = search->order->history[side][move.from][move.to] + (kind >= PIECE_DARK_MAN ? gain : -gain);
         }
     }
-}   
+}
 
-static struct AiMoves minimax(struct Ai* ai) {
-    if (!ai->checkers->flags.run || ai->checkers->state != CSTATE_P2_TURN) {
-        return invalidMove;
+/* a quiet move that cut off becomes the first killer of its ply and gains history */
+static void recordCutoff(struct Search* search, struct Board* gameboard, struct Move move, int depth, int ply) {
+    if (move.captured != CHECKERS_NO_SQUARE) {
+        return;
+    }
+    struct OrderTables* order = search->order;
+    if (ply < KILLER_PLIES && !sameMove(move, order->killers[ply][0])) {
+        order->killers[ply][1] = order->killers[ply][0];
+        order->killers[ply][0] = move;
+    }
+    int32_t* entry = &order->history[gameboard->sideToMove][move.from][move.to];
+    *entry += depth * depth;
+    if (*entry > HISTORY_MAX) {
+        int32_t* history = &order->history[0][0][0];
+        for (size_t i = 0; i < sizeof(order->history) / sizeof(int32_t); i++) {
+            history[i] /= 2;
+        }
+    }
+}
+
+/* between moves the killers belong to plies of another position, and old history only half counts */
+static void ageOrderTables(struct OrderTables* order) {
+    memset(order->killers, 0, sizeof(order->killers));
+    int32_t* history = &order->history[0][0][0];
+    for (size_t i = 0; i < sizeof(order->history) / sizeof(int32_t); i++) {
+        history[i] /= 2;
+    }
+}
+
+/* selection sort step: brings the best of the remaining moves to index i */
+static inline void pickNextMove(struct MoveList* moves, int32_t* scores, size_t i) {
+    size_t best = i;
+    for (size_t j = i + 1; j < moves->size; j++) {
+        if (scores[j] > scores[best]) {
+            best = j;
+        }
     }
-    struct AiMoves res = invalidMove;
-    size_t mSize;
-    struct Moves* movesList = boardGetAvailableMovesForPlayer(&ai->checkers->checkersBoard, CHECKERS_PLAYER_TWO, ai->checkers->flags.forceCapture, &mSize);
-    if (mSize > 0) {
-        shuffle(movesList, mSize); 
-    }
-    double heuristic = LONG_MIN;
-    if (ai->checkers->flags.forceCapture && boardCheckIfPlayerCanCapture(&ai->checkers->checkersBoard, CHECKERS_PLAYER_TWO)) {
-        for (size_t i = 0; i < mSize; i++) {
-            if (!boardCheckIfPieceCanCapture(&ai->checkers->checkersBoard, CHECKERS_PLAYER_TWO, movesList[i].from)) {
-                continue;
+    if (best != i) {
+        struct Move move = moves->moves[i];
+        moves->moves[i] = moves->moves[best];
+        moves->moves[best] = move;
+        int32_t score = scores[i];
+        scores[i] = scores[best];
+        scores[best] = score;
+    }
+}
+
+/**
+ * Plays move and searches what follows. A capture the same piece goes on with
+ * keeps the side to move, so its score is not negated, and the whole capture
+ * costs a single ply of depth; the next node may only continue it.
+ */
+static aiscore searchMove(struct Search* search, struct Board* gameboard, struct Move move, int depth, int ply, aiscore alpha, aiscore beta) {
+    struct MoveUndo undo;
+    boardMakeChainedMove(gameboard, move, search->forceCapture, &undo);
+    aiscore score = undo.chained
+        ? negamax(search, gameboard, depth, ply + 1, alpha, beta, move.to)
+        : -negamax(search, gameboard, depth - 1, ply + 1, -beta, -alpha, -1);
+    boardUnmakeMove(gameboard, &undo);
+    return score;
+}
+
+/* move is the best so far at ply, the line the child left one row below follows it */
+static inline void updatePv(struct Search* search, int ply, struct Move move) {
+    if (ply >= AI_MAX_PV) {
+        return;
+    }
+    int length = ply + 1 < AI_MAX_PV ? search->pvLength[ply + 1] : ply + 1;
+    search->pv[ply][ply] = move;
+    for (int i = ply + 1; i < length; i++) {
+        search->pv[ply][i] = search->pv[ply + 1][i];
+    }
+    search->pvLength[ply] = length;
+}
+
+/* the same position with a capture under way is a different node, its key is moved away from the plain one */
+static inline uint64_t nodeKey(struct Board* gameboard, int chain) {
+    return chain < 0 ? gameboard->hash : gameboard->hash ^ (((uint64_t) chain + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+/* a few points of deterministic noise so helper threads walk the root in different orders */
+static inline int32_t helperNoise(int helper, size_t i, int depth) {
+    uint64_t x = ((uint64_t) helper << 40 | (uint64_t) depth << 20 | i) * 0x9E3779B97F4A7C15ULL;
+    return (int32_t) (x >> 61) * CHECKERS_EVAL_SCALE;
+}
+
+/**
+ * One pass over the root moves inside (alpha, beta), principal variation style:
+ * the first move gets the whole window, the others a null window just below
+ * the best score and a full search only if they reach it. The window is opened
+ * one unit below the best score rather than at it, so moves that tie it get
+ * exact scores too; their lines are left in ties. The result is exact only
+ * strictly inside the window.
+ */
+static aiscore searchRoot(struct Search* search, struct Board* board, struct MoveList* moves, int32_t* scores, int depth, aiscore alpha, aiscore beta, struct PvLine* ties, size_t* tiesSize) {
+    aiscore best = -AI_SCORE_INFINITE;
+    *tiesSize = 0;
+    for (size_t i = 0; i < moves->size; i++) {
+        pickNextMove(moves, scores, i);
+        struct Move move = moves->moves[i];
+        aiscore floor = best - 1 > alpha ? best - 1 : alpha;
+        aiscore score;
+        if (i == 0) {
+            score = searchMove(search, board, move, depth, 0, alpha, beta);
+        } else {
+            score = searchMove(search, board, move, depth, 0, floor, floor + 1);
+            if (score > floor && score < beta && !search->stopped) {
+                score = searchMove(search, board, move, depth, 0, floor, beta);
             }
-            for (size_t j = 0; j < movesList[i].to_size; j++) {
-                struct Point from = movesList[i].from;
-                struct Point to = movesList[i].to[j];
-                struct Board future = ai->checkers->checkersBoard;
-                int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_TWO, from, to);
-                if (status != CHECKERS_CAPTURE_SUCCESS) {
-                    continue;
-                }
-                double tmp = minimaxr(&future, ai->checkers->flags.forceCapture, AI_DEPTH, false);
-                if (tmp > heuristic) {
-                    heuristic = tmp;
-                    res = (struct AiMoves){ .valid = 1, .from = movesList[i].from, .to = movesList[i].to[j] };
-                }
+        }
+        if (search->stopped) {
+            break;
+        }
+        scores[i] = score;
+        if (score > best) {
+            best = score;
+            *tiesSize = 0;
+        }
+        if (score == best && score > alpha && score < beta) {
+            struct PvLine* line = &ties[(*tiesSize)++];
+            line->moves[0] = move;
+            line->size = 1;
+            for (int k = 1; k < search->pvLength[1] && k < AI_MAX_PV; k++) {
+                line->moves[line->size++] = search->pv[1][k];
             }
         }
-    } else {
-        for (size_t i = 0; i < mSize; i++) {
-            for (size_t j = 0; j < movesList[i].to_size; j++) {
-                struct Point from = movesList[i].from;
-                struct Point to = movesList[i].to[j];
-                struct Board future = ai->checkers->checkersBoard;
-                int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_TWO, from, to);
-                if (status != CHECKERS_MOVE_SUCCESS && status != CHECKERS_CAPTURE_SUCCESS) {
-                    continue;   
-                }
-                double tmp = minimaxr(&future, ai->checkers->flags.forceCapture, AI_DEPTH, false);
-                if (tmp > heuristic) {
-                    heuristic = tmp;
-                    res = (struct AiMoves){ .valid = 1, .from = movesList[i].from, .to = movesList[i].to[j] };
-                }
+        if (best >= beta) {
+            break;
+        }
+    }
+    return best;
+}
+
+/* the caller does not hold the mutex, which is released again before onIteration runs */
+static void publishPv(struct Ai* ai, struct PvLine* line, int depth, aiscore score) {
+    atomic_store(&ai->stats.depth, depth);
+    struct AiLine published = {
+        .depth = depth,
+        .score = score,
+        .size = line->size
+    };
+    for (int i = 0; i < line->size; i++) {
+        published.moves[i] = (struct AiMoves){
+            .valid = 1,
+            .from = boardPointFromSquare(line->moves[i].from),
+            .to = boardPointFromSquare(line->moves[i].to)
+        };
+    }
+    lockMutex(ai);
+    ai->queue.pv = published;
+    unlockMutex(ai);
+    if (ai->config.onIteration) {
+        ai->config.onIteration(ai->config.context, &published);
+    }
+}
+
+/**
+ * Iterative deepening: each iteration orders the root moves by the scores of the
+ * previous one and seeds the table with its best move, so the next depth starts
+ * from the line that was best so far. Past the first plies an iteration starts
+ * with an aspiration window around the previous score, widened and searched
+ * again whenever the score falls outside. Only completed iterations count,
+ * their equally best moves and lines are left in ties. Helpers start one ply
+ * deeper on odd indices and shuffle equal-ish root moves, so they rarely search
+ * the same subtree at the same time as the main thread.
+ */
+static size_t iterativeDeepening(struct Search* search, struct Board* board, int maxDepth, struct PvLine* ties) {
+    struct MoveList moves;
+    boardGenerateMoves(board, board->sideToMove, search->forceCapture, &moves);
+    if (moves.size == 0) {
+        return 0;
+    }
+    struct TtEntry entry = {0};
+    int32_t scores[CHECKERS_MAX_MOVES];
+    ttProbe(search->tt, board->hash, &entry);
+    scoreMoves(search, board, &moves, entry.best, 0, scores);
+
+    // until the first iteration completes, the best ordered move is the answer
+    size_t tiesSize = 1;
+    pickNextMove(&moves, scores, 0);
+    ties[0].moves[0] = moves.moves[0];
+    ties[0].size = 1;
+    for (int depth = 1 + (search->helper & 1); depth <= maxDepth && moves.size > 1; depth++) {
+        TRACE_SCOPE("iteration");
+        if (search->helper) {
+            for (size_t i = 0; i < moves.size; i++) {
+                scores[i] += helperNoise(search->helper, i, depth);
             }
         }
+        aiscore delta = ASPIRATION_WINDOW;
+        aiscore alpha = -AI_SCORE_INFINITE;
+        aiscore beta = AI_SCORE_INFINITE;
+        if (depth > 2 && !aiScoreIsDecided(search->score)) {
+            alpha = search->score - delta;
+            beta = search->score + delta;
+        }
+        aiscore best;
+        struct PvLine iterationTies[CHECKERS_MAX_MOVES];
+        size_t iterationTiesSize;
+        for (;;) {
+            best = searchRoot(search, board, &moves, scores, depth, alpha, beta, iterationTies, &iterationTiesSize);
+            if (search->stopped || (best > alpha && best < beta)) {
+                break;
+            }
+            delta *= 4;
+            int full = delta > ASPIRATION_MAX || aiScoreIsDecided(best);
+            if (best <= alpha) {
+                alpha = full ? -AI_SCORE_INFINITE : best - delta;
+            } else {
+                beta = full ? AI_SCORE_INFINITE : best + delta;
+            }
+        }
+        if (search->stopped) {
+            break;
+        }
+        memcpy(ties, iterationTies, sizeof(struct PvLine) * iterationTiesSize);
+        tiesSize = iterationTiesSize;
+        search->depth = depth;
+        search->score = best;
+        ttStore(search->tt, board->hash, depth, best, TT_BOUND_EXACT, ties[0].moves[0]);
+        shareCounters(search);
+        if (search->owner) {
+            TRACE_COUNTER("depth", depth);
+            TRACE_COUNTER("nodes", (int64_t) search->nodes);
+            publishPv(search->owner, &ties[0], depth, best);
+        }
+        // a decided game will not change with depth, and the next iteration usually costs more than all before it
+        uint64_t softDeadline = loadDeadline(search->softDeadline);
+        if (aiScoreIsDecided(best) || (softDeadline && clockMs() >= softDeadline)) {
+            break;
+        }
     }
-    checkersDestroyMovesList(movesList, mSize);
-    if (!res.valid) {
+    shareCounters(search);
+    return tiesSize;
+}
+
+static THREAD_RETURN helperSearch(void* arg) {
+    TRACE_THREAD_BEGIN("ai helper");
+    struct Helper* helper = (struct Helper*) arg;
+    struct PvLine ties[CHECKERS_MAX_MOVES];
+    iterativeDeepening(&helper->search, &helper->board, helper->maxDepth, ties);
+    TRACE_THREAD_END();
+    return 0;
+}
+
+/* a weighted pick among the book moves of the position, checked against the generator */
+static int probeBook(struct Ai* ai, struct Board* board, int forceCapture, struct Move* out) {
+    struct Move bookMove;
+    if (!ai->book || !bookPick(ai->book, board, nextRandom(ai), &bookMove)) {
+        return 0;
+    }
+    struct MoveList moves;
+    boardGenerateMoves(board, board->sideToMove, forceCapture, &moves);
+    for (size_t i = 0; i < moves.size; i++) {
+        if (sameMove(moves.moves[i], bookMove)) {
+            *out = moves.moves[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* the counters start over with every search, book moves included */
+static void startStats(struct Ai* ai) {
+    atomic_store(&ai->stats.end, 0);
+    atomic_store(&ai->stats.depth, 0);
+    for (int i = 0; i < ai->config.threads; i++) {
+        struct SearchCounters* counters = &ai->stats.threads[i];
+        atomic_store(&counters->nodes, 0);
+        atomic_store(&counters->expanded, 0);
+        atomic_store(&counters->cutoffs, 0);
+        atomic_store(&counters->firstCutoffs, 0);
+        atomic_store(&counters->probes, 0);
+        atomic_store(&counters->hits, 0);
+        atomic_store(&counters->selDepth, 0);
+    }
+    atomic_store(&ai->stats.start, clockMs());
+}
+
+/**
+ * Lazy SMP: the helpers run the same search on their own copies of the board and
+ * talk to the main thread only through the table. Their results are dropped, the
+ * main thread stops them as soon as it has its move.
+ */
+static struct AiMoves minimax(struct Ai* ai, struct Board* board, int forceCapture) {
+    TRACE_SCOPE("search");
+    startStats(ai);
+    struct Move bookMove;
+    if (probeBook(ai, board, forceCapture, &bookMove)) {
+        publishPv(ai, &(struct PvLine){ .size = 1, .moves = { bookMove } }, 0, 0);
+        atomic_store(&ai->stats.end, clockMs());
+        return (struct AiMoves){
+            .valid = 1,
+            .from = boardPointFromSquare(bookMove.from),
+            .to = boardPointFromSquare(bookMove.to)
+        };
+    }
+    atomic_int done = 0;
+    lockMutex(ai);
+    ai->queue.pv.size = 0;
+    unlockMutex(ai);
+    for (int i = 0; i < ai->config.threads; i++) {
+        ageOrderTables(&ai->order[i]);
+    }
+    struct Search search = {
+        .tt = ai->tt,
+        .tb = ai->tb,
+        .order = &ai->order[0],
+        .shared = &ai->stats.threads[0],
+        .owner = ai,
+        .forceCapture = forceCapture,
+        .nodeLimit = ai->config.nodeLimit,
+        .deadline = &ai->deadline,
+        .softDeadline = &ai->softDeadline,
+        .done = &ai->stop
+    };
+    ttNewSearch(ai->tt);
+
+    int helpersSize = 0;
+    struct Helper* helpers = ai->config.threads > 1 ? calloc(ai->config.threads - 1, sizeof(struct Helper)) : NULL;
+    for (int i = 0; helpers && i < ai->config.threads - 1; i++) {
+        helpers[helpersSize].search = (struct Search){
+            .tt = ai->tt,
+            .tb = ai->tb,
+            .order = &ai->order[i + 1],
+            .shared = &ai->stats.threads[i + 1],
+            .forceCapture = search.forceCapture,
+            .helper = i + 1,
+            .done = &done
+        };
+        helpers[helpersSize].board = *board;
+        helpers[helpersSize].maxDepth = ai->config.maxDepth;
+        helpersSize += startHelper(&helpers[helpersSize]);
+    }
+
+    struct PvLine ties[CHECKERS_MAX_MOVES];
+    size_t tiesSize = iterativeDeepening(&search, board, ai->config.maxDepth, ties);
+
+    atomic_store(&done, 1);
+    for (int i = 0; i < helpersSize; i++) {
+        joinHelper(&helpers[i]);
+        ttAddStats(ai->tt, &helpers[i].search.counters);
+    }
+    free(helpers);
+    ttAddStats(ai->tt, &search.counters);
+    atomic_store(&ai->stats.end, clockMs());
+    if (tiesSize == 0) {
         return invalidMove;
     }
-    return res;
+    // the line shown is the one of the move played
+    size_t pick = pickRandom(ai, tiesSize);
+    if (pick != 0 || search.depth == 0) {
+        publishPv(ai, &ties[pick], search.depth, search.score);
+    }
+    struct Move chosen = ties[pick].moves[0];
+    return (struct AiMoves){
+        .valid = 1,
+        .from = boardPointFromSquare(chosen.from),
+        .to = boardPointFromSquare(chosen.to)
+    };
 }
 
-static double minimaxr(struct Board* gameboard, int forceCapture, int depth, int maximize) {
-    if (depth == 0 || gameboard->remainingDarkPieces == 0 || gameboard->remainingLightPieces == 0) {
-        return heuristics(gameboard);
+/* scores are from the point of view of gameboard->sideToMove, ply counts from the root */
+/* chain is the square of a piece in the middle of a capture, which is all that may move, -1 otherwise */
+static aiscore negamax(struct Search* search, struct Board* gameboard, int depth, int ply, aiscore alpha, aiscore beta, int chain) {
+    search->nodes += 1;
+    if (ply > search->selDepth) {
+        search->selDepth = ply;
     }
-    if (maximize) {
-        // ai
-        double res = INT_MIN;
-        size_t movesSize = 0;
-        struct Moves* moves = boardGetAvailableMovesForPlayer(gameboard, CHECKERS_PLAYER_TWO, forceCapture, &movesSize);
-        if (forceCapture && boardCheckIfPlayerCanCapture(gameboard, CHECKERS_PLAYER_TWO)) {
-            for (size_t i = 0; i < movesSize; i++) {
-                if (!boardCheckIfPieceCanCapture(gameboard, CHECKERS_PLAYER_TWO, moves[i].from)) {
-                    continue;
-                }
-                for (size_t j = 0; j < moves[i].to_size; j++) {
-                    struct Point from = moves[i].from;
-                    struct Point to = moves[i].to[j];
-                    struct Board future = *gameboard;
-                    int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_TWO, from, to);
-                    if (status != CHECKERS_CAPTURE_SUCCESS) {
-                        continue;
-                    }
-                    double tmp = minimaxr(&future, forceCapture, depth - 1, false);
-                    if (tmp > res) {
-                        res = tmp;
-                    }
-                }
-            }
+    if (ply < AI_MAX_PV) {
+        search->pvLength[ply] = ply;
+    }
+    if ((search->nodes & LIMITS_CHECK_INTERVAL) == 0 && outOfBudget(search)) {
+        return 0;
+    }
+    // a side without pieces cannot move, same as a blocked one
+    int ownPieces = gameboard->sideToMove == CHECKERS_PLAYER_TWO ? gameboard->remainingDarkPieces : gameboard->remainingLightPieces;
+    if (ownPieces == 0) {
+        return -(AI_SCORE_WIN - ply);
+    }
+    // the root still needs a move, everywhere else a solved ending is exact
+    if (search->tb && ply > 0 && chain < 0) {
+        int distance;
+        int result = tbProbe(search->tb, gameboard, &distance);
+        if (result == TB_DRAW) {
+            return 0;
+        } else if (result == TB_WIN) {
+            return AI_SCORE_WIN - (ply + distance);
+        } else if (result == TB_LOSS) {
+            return -(AI_SCORE_WIN - (ply + distance));
+        }
+    }
+    if (depth == 0) {
+        return quiescence(search, gameboard, ply, alpha, beta, chain);
+    }
+    aiscore alphaOrig = alpha;
+    uint64_t key = nodeKey(gameboard, chain);
+    struct TtEntry entry = {0};
+    int hit = ttProbe(search->tt, key, &entry);
+    search->counters.probes += 1;
+    search->counters.hits += hit;
+    // a full window node would lose its line to the cutoff, so only null windows take one
+    if (hit && entry.depth >= depth && beta - alpha == 1) {
+        aiscore score = aiScoreFromTt(entry.score, ply);
+        if (entry.bound == TT_BOUND_EXACT) {
+            return score;
+        } else if (entry.bound == TT_BOUND_LOWER && score > alpha) {
+            alpha = score;
+        } else if (entry.bound == TT_BOUND_UPPER && score < beta) {
+            beta = score;
+        }
+        if (alpha >= beta) {
+            return score;
+        }
+    }
+
+    struct MoveList moves;
+    if (chain >= 0) {
+        boardGenerateChainMoves(gameboard, chain, search->forceCapture, &moves);
+    } else {
+        boardGenerateMoves(gameboard, gameboard->sideToMove, search->forceCapture, &moves);
+    }
+    if (moves.size == 0) {
+        return -(AI_SCORE_WIN - ply);
+    }
+    int32_t scores[CHECKERS_MAX_MOVES];
+    scoreMoves(search, gameboard, &moves, entry.best, ply, scores);
+    search->expanded += 1;
+
+    // principal variation search: after the first move, a null window only asks whether a move beats alpha
+    aiscore best = -AI_SCORE_INFINITE;
+    struct Move bestMove = {0};
+    for (size_t i = 0; i < moves.size; i++) {
+        pickNextMove(&moves, scores, i);
+        aiscore score;
+        if (i == 0) {
+            score = searchMove(search, gameboard, moves.moves[i], depth, ply, alpha, beta);
         } else {
-            for (size_t i = 0; i < movesSize; i++) {
-                for (size_t j = 0; j < moves[i].to_size; j++) {
-                    struct Point from = moves[i].from;
-                    struct Point to = moves[i].to[j];
-                    struct Board future = *gameboard;
-                    int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_TWO, from, to);
-                    if (status != CHECKERS_MOVE_SUCCESS && status != CHECKERS_CAPTURE_SUCCESS) {
-                        continue;
-                    }
-                    double tmp = minimaxr(&future, forceCapture, depth - 1, false);
-                    if (tmp > res) {
-                        res = tmp;
-                    }
-                }
+            score = searchMove(search, gameboard, moves.moves[i], depth, ply, alpha, alpha + 1);
+            if (score > alpha && score < beta && !search->stopped) {
+                score = searchMove(search, gameboard, moves.moves[i], depth, ply, alpha, beta);
             }
         }
-        checkersDestroyMovesList(moves, movesSize);
-        return res;
-    } else {
-        // player
-        double res = INT_MAX;
-        size_t movesSize = 0;
-        struct Moves* moves = boardGetAvailableMovesForPlayer(gameboard, CHECKERS_PLAYER_ONE, forceCapture, &movesSize);
-        if (forceCapture && boardCheckIfPlayerCanCapture(gameboard, CHECKERS_PLAYER_ONE)) {
-            for (size_t i = 0; i < movesSize; i++) {
-                if (!boardCheckIfPieceCanCapture(gameboard, CHECKERS_PLAYER_ONE, moves[i].from)) {
-                    continue;
-                }
-                for (size_t j = 0; j < moves[i].to_size; j++) {
-                    struct Point from = moves[i].from;
-                    struct Point to = moves[i].to[j];
-                    struct Board future = *gameboard;
-                    int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_ONE, from, to);
-                    if (status != CHECKERS_CAPTURE_SUCCESS) {
-                        continue;
-                    }
-                    double tmp = minimaxr(&future, forceCapture, depth - 1, true);
-                    if (tmp < res) {
-                        res = tmp;
-                    }
+        if (search->stopped) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            bestMove = moves.moves[i];
+            if (score > alpha) {
+                alpha = score;
+                updatePv(search, ply, bestMove);
+                if (alpha >= beta) {
+                    recordCutoff(search, gameboard, bestMove, depth, ply);
+                    search->cutoffs += 1;
+                    search->firstCutoffs += i == 0;
+                    break;
                 }
             }
-        } else {
-            for (size_t i = 0; i < movesSize; i++) {
-                for (size_t j = 0; j < moves[i].to_size; j++) {
-                    struct Point from = moves[i].from;
-                    struct Point to = moves[i].to[j];
-                    struct Board future = *gameboard;
-                    int status = boardTryMoveOrCapture(&future, CHECKERS_PLAYER_ONE, from, to);
-                    if (status != CHECKERS_MOVE_SUCCESS && status != CHECKERS_CAPTURE_SUCCESS) {
-                        continue;
-                    }
-                    double tmp = minimaxr(&future, forceCapture, depth - 1, true);
-                    if (tmp < res) {
-                        res = tmp;
-                    }
+        }
+    }
+    int bound = best <= alphaOrig ? TT_BOUND_UPPER : best >= beta ? TT_BOUND_LOWER : TT_BOUND_EXACT;
+    search->counters.stores += 1;
+    search->counters.replacements += ttStore(search->tt, key, depth, aiScoreToTt(best, ply), bound, bestMove);
+    return best;
+}
+
+/**
+ * Below the nominal depth only captures are searched, so no leaf is scored in
+ * the middle of an exchange. A side that cannot capture stands on the static
+ * evaluation; one that can must take when captures are forced, and otherwise
+ * may still stand pat and only looks at captures that do better. Every capture
+ * removes a piece, so the lines are short and need no depth limit.
+ */
+static aiscore quiescence(struct Search* search, struct Board* gameboard, int ply, aiscore alpha, aiscore beta, int chain) {
+    search->nodes += 1;
+    if (ply > search->selDepth) {
+        search->selDepth = ply;
+    }
+    if ((search->nodes & LIMITS_CHECK_INTERVAL) == 0 && outOfBudget(search)) {
+        return 0;
+    }
+    int ownPieces = gameboard->sideToMove == CHECKERS_PLAYER_TWO ? gameboard->remainingDarkPieces : gameboard->remainingLightPieces;
+    if (ownPieces == 0) {
+        return -(AI_SCORE_WIN - ply);
+    }
+    aiscore eval = heuristics(gameboard);
+    aiscore standPat = gameboard->sideToMove == CHECKERS_PLAYER_TWO ? eval : -eval;
+    struct MoveList captures;
+    if (chain >= 0) {
+        boardGenerateChainMoves(gameboard, chain, search->forceCapture, &captures);
+    } else if (boardGenerateCaptures(gameboard, gameboard->sideToMove, search->forceCapture, &captures) == 0) {
+        return standPat;
+    }
+    aiscore best = -AI_SCORE_INFINITE;
+    if (!search->forceCapture) {
+        best = standPat;
+        if (best >= beta) {
+            return best;
+        }
+        if (best > alpha) {
+            alpha = best;
+        }
+    }
+    int32_t scores[CHECKERS_MAX_MOVES];
+    scoreMoves(search, gameboard, &captures, (struct Move){ .from = CHECKERS_NO_SQUARE, .to = CHECKERS_NO_SQUARE }, ply, scores);
+    for (size_t i = 0; i < captures.size; i++) {
+        pickNextMove(&captures, scores, i);
+        struct MoveUndo undo;
+        boardMakeChainedMove(gameboard, captures.moves[i], search->forceCapture, &undo);
+        aiscore score = undo.chained
+            ? quiescence(search, gameboard, ply + 1, alpha, beta, captures.moves[i].to)
+            : -quiescence(search, gameboard, ply + 1, -beta, -alpha, -1);
+        boardUnmakeMove(gameboard, &undo);
+        if (search->stopped) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
                 }
             }
         }
-        checkersDestroyMovesList(moves, movesSize);
-        return res;
     }
+    return best;
 }
 
 // light - opponent
 // dark  - me
-static double heuristics(struct Board* gameboard) {
-    double rewards = 0.0f;
-    if (gameboard->remainingDarkPieces == 0) {
-        rewards -= 1000.0f;
-    } else if (gameboard->remainingLightPieces == 0) {
-        rewards += 1000.0f;
-    }
-    for (uint8_t i = 0; i < gameboard->boardSize; i++) {
-        for (uint8_t j = 0; j < gameboard->boardSize; j++) {
-            char ch = gameboard->board[i][j];
-            if (ch == gameboard->pieceLightMan) {
-                rewards -= 20.0f;
-                rewards -= ((10.0f - (i + 1)) / 10.0f) * 10.0f;
-                rewards -= (1 - (0.5f/fabs(j - 5.5f))) * 20;
-            } else if (ch == gameboard->pieceLightKing) {
-                rewards -= 100.0f;
-                rewards -= ((10.0f - (i + 1)) / 10.0f) * 10.0f;
-                rewards -= (1 - (0.5f/fabs(j - 5.5f))) * 20;
-            } else if (ch == gameboard->pieceDarkMan) {
-                rewards += 20.0f;
-                rewards += ((i + 1) / 10.0f) * 10.0f;
-                rewards += (1 - (0.5f/fabs(j - 5.5f))) * 20;
-            } else if (ch == gameboard->pieceDarkKing) {
-                rewards += 100.0f;
-                rewards += ((i + 1) / 10.0f) * 10.0f;
-                rewards += (1 - (0.5f/fabs(j - 5.5f))) * 20;
-            }
-        }
-    }
-    return rewards;
+// the piece-square sum is kept on the board by every make and unmake,
+// a side without pieces never gets here, negamax scores it as a loss
+static aiscore heuristics(struct Board* gameboard) {
+    return gameboard->eval;
 }
 
 /**
@@ -338,66 +1116,137 @@ static double heuristics(struct Board* gameboard) {
  * 
  */
 
-#ifdef _WIN32
-static void threadGenMoves(void* arg) {
-#else
-static void* threadGenMoves(void* arg) {
-#endif
+/* the caller holds the mutex */
+static void cancelLocked(struct Ai* ai) {
+    ai->queue.pending = 0;
+    ai->queue.ponder = 0;
+    ai->queue.ponderKey = 0;
+    ai->queue.content = invalidMove;
+    if (ai->queue.busy) {
+        atomic_store(&ai->stop, 1);
+        while (ai->queue.busy) {
+            waitChanged(ai);
+        }
+    }
+}
+
+/* the caller holds the mutex; a ponder search runs until it is hit or cancelled */
+static void startClockLocked(struct Ai* ai, int ponder, uint64_t start) {
+    int timed = !ponder && ai->config.timeMs;
+    atomic_store(&ai->softDeadline, timed ? start + ai->config.timeMs / 2 : 0);
+    atomic_store(&ai->deadline, timed ? start + ai->config.timeMs : 0);
+}
+
+static THREAD_RETURN threadGenMoves(void* arg) {
     struct Ai* ai = (struct Ai*) arg;
+    TRACE_THREAD_BEGIN("ai worker");
 
     lockMutex(ai);
-    struct AiMoves res = minimax(ai);
-    if (res.valid) {
-        ai->queue.content = res;
-    } else {
-        ai->queue.content = invalidMove;
+    while (!ai->queue.quit) {
+        if (!ai->queue.pending || ai->queue.busy) {
+            waitChanged(ai);
+            continue;
+        }
+        struct Board board = ai->queue.board;
+        int forceCapture = ai->queue.forceCapture;
+        ai->queue.pending = 0;
+        ai->queue.busy = 1;
+        ai->queue.busyPonder = ai->queue.ponder;
+        ai->queue.busyKey = board.hash;
+        ai->queue.busyStart = clockMs();
+        atomic_store(&ai->stop, 0);
+        startClockLocked(ai, ai->queue.ponder, ai->queue.busyStart);
+        unlockMutex(ai);
+
+        struct AiMoves res = minimax(ai, &board, forceCapture);
+
+        lockMutex(ai);
+        // a cancelled search still returns its best guess, which nobody asked for anymore,
+        // and a ponder search without a guess has found a move for the opponent
+        if (!atomic_load(&ai->stop) && res.valid && board.sideToMove == CHECKERS_PLAYER_TWO) {
+            ai->queue.content = res;
+            ai->queue.contentKey = board.hash;
+        }
+        ai->queue.busy = 0;
+        ai->queue.busyPonder = 0;
+        broadcastChanged(ai);
     }
     unlockMutex(ai);
-    
+    TRACE_THREAD_END();
+    return 0;
+}
+
+static inline int createThread(struct Ai* ai) {
+    TRACE_SCOPE("createThread");
     #ifdef _WIN32
-    _endthread();
+    ai->tid = _beginthreadex(NULL, 0, threadGenMoves, (void*) ai, 0, NULL);
+    return ai->tid != 0;
     #else
-    pthread_exit(NULL);
+    return pthread_create(&ai->tid, NULL, threadGenMoves, (void*) ai) == 0;
     #endif
 }
 
-static inline int createThread(struct Ai* ai) {
+static inline void joinThread(struct Ai* ai) {
+    TRACE_SCOPE("joinThread");
     #ifdef _WIN32
-    ai->tid = _beginthread(threadGenMoves, 0, (void*) ai);
-    return ai->tid != (uintptr_t) -1L;
+    WaitForSingleObject((HANDLE) ai->tid, INFINITE);
+    CloseHandle((HANDLE) ai->tid);
     #else
-    return pthread_create(&ai->tid, NULL, threadGenMoves, (void*) ai) == 0;
+    pthread_join(ai->tid, NULL);
     #endif
 }
 
-static inline int createMutex(struct Ai* ai) {
+static inline int startHelper(struct Helper* helper) {
+    TRACE_SCOPE("startHelper");
     #ifdef _WIN32
-    ai->queue.mutex = CreateMutexA(NULL, FALSE, NULL);
-    return ai->queue.mutex != NULL;
+    helper->tid = _beginthreadex(NULL, 0, helperSearch, (void*) helper, 0, NULL);
+    return helper->tid != 0;
     #else
-    return pthread_mutex_init(&ai->queue.mutex, NULL) == 0;
+    return pthread_create(&helper->tid, NULL, helperSearch, (void*) helper) == 0;
     #endif
 }
 
-static inline int destroyMutex(struct Ai* ai) {
+static inline void joinHelper(struct Helper* helper) {
+    TRACE_SCOPE("joinHelper");
     #ifdef _WIN32
-    return CloseHandle(ai->queue.mutex);
+    WaitForSingleObject((HANDLE) helper->tid, INFINITE);
+    CloseHandle((HANDLE) helper->tid);
     #else
-    return pthread_mutex_destroy(&ai->queue.mutex) == 0;
+    pthread_join(helper->tid, NULL);
+    #endif
+}
+
+static inline int createMutex(struct Ai* ai) {
+    #ifdef _WIN32
+    InitializeCriticalSection(&ai->queue.mutex);
+    InitializeConditionVariable(&ai->queue.changed);
+    return 1;
+    #else
+    if (pthread_mutex_init(&ai->queue.mutex, NULL) != 0) {
+        return 0;
+    }
+    if (pthread_cond_init(&ai->queue.changed, NULL) != 0) {
+        pthread_mutex_destroy(&ai->queue.mutex);
+        return 0;
+    }
+    return 1;
     #endif
 }
 
-static inline int tryLockMutex(struct Ai* ai) {
+static inline int destroyMutex(struct Ai* ai) {
     #ifdef _WIN32
-    return WaitForSingleObject(ai->queue.mutex, 0) == WAIT_OBJECT_0;
+    DeleteCriticalSection(&ai->queue.mutex);
+    return 1;
     #else
-    return pthread_mutex_trylock(&ai->queue.mutex) == 0;
+    pthread_cond_destroy(&ai->queue.changed);
+    return pthread_mutex_destroy(&ai->queue.mutex) == 0;
     #endif
 }
 
 static inline int lockMutex(struct Ai* ai) {
     #ifdef _WIN32
-    return WaitForSingleObject(ai->queue.mutex, INFINITE) == WAIT_OBJECT_0;
+    EnterCriticalSection(&ai->queue.mutex);
+    return 1;
     #else
     return pthread_mutex_lock(&ai->queue.mutex) == 0;
     #endif
@@ -405,8 +1254,26 @@ static inline int lockMutex(struct Ai* ai) {
 
 static inline int unlockMutex(struct Ai* ai) {
     #ifdef _WIN32
-    return ReleaseMutex(ai->queue.mutex);
+    LeaveCriticalSection(&ai->queue.mutex);
+    return 1;
     #else
     return pthread_mutex_unlock(&ai->queue.mutex) == 0;
     #endif
-}
\ No newline at end of file
+}
+
+static inline int waitChanged(struct Ai* ai) {
+    #ifdef _WIN32
+    return SleepConditionVariableCS(&ai->queue.changed, &ai->queue.mutex, INFINITE);
+    #else
+    return pthread_cond_wait(&ai->queue.changed, &ai->queue.mutex) == 0;
+    #endif
+}
+
+static inline int broadcastChanged(struct Ai* ai) {
+    #ifdef _WIN32
+    WakeAllConditionVariable(&ai->queue.changed);
+    return 1;
+    #else
+    return pthread_cond_broadcast(&ai->queue.changed) == 0;
+    #endif
+}
@@ -1,21 +1,89 @@
 #ifndef CHECKERS_AI_H
 #define CHECKERS_AI_H
 
-#define AI_DEPTH 5
+#define AI_MAX_DEPTH 64
+#define AI_DEFAULT_TIME_MS 1000
+#define AI_DEFAULT_TT_MEGABYTES 16
+#define AI_MAX_THREADS 64
+#define AI_DEFAULT_TABLEBASE_PATH "tablebases"
+#define AI_DEFAULT_BOOK_PATH "book.ckb"
+#define AI_MAX_PV 64
 
 #include "checkers.h"
+#include "checkers_tt.h"
 
 struct AiMoves {
     int valid;
     struct Point from, to;
 };
 
+/* the line the search expects from the position it last searched, one hop per move, its own move first */
+struct AiLine {
+    int depth;      /* of the iteration that found it, 0 for a book move */
+    aiscore score;  /* for the side to move, see checkers_score.h */
+    int size;
+    struct AiMoves moves[AI_MAX_PV];
+};
+
+/**
+ * Counters of the running search, or of the last one once it has ended. The
+ * threads bring them up to date every thousand nodes or so, so a running
+ * search reads slightly behind. Nodes, cutoffs and table probes add up all
+ * threads, depth and selDepth are the main thread's.
+ */
+struct AiStats {
+    int running;
+    int depth;          /* last completed iteration, 0 before the first and for a book move */
+    int selDepth;       /* deepest ply reached, quiescence included, one per hop of a capture */
+    uint64_t nodes;
+    uint64_t nps;
+    uint64_t elapsedMs;
+    double cutoffRate;      /* of the nodes that searched their moves, the share that failed high */
+    double firstCutoffRate; /* of those, the share whose first move did */
+    uint64_t ttProbes;
+    uint64_t ttHits;
+};
+
+/**
+ * The search deepens one ply at a time until maxDepth is reached or the
+ * time or node budget runs out, whichever comes first, and plays the best
+ * move of the last depth it completed. A zero budget means no limit.
+ *
+ * With more than one thread, the extra ones search the same position with
+ * shifted depths and move orders and only fill the shared table for the main
+ * one; the node limit counts the main thread's nodes.
+ *
+ * A position found in the opening book is answered from it without a search.
+ *
+ * onIteration, if set, gets every line checkersAiGetPv would return, as soon as
+ * it is found, on the thread that searches; it should return quickly.
+ */
+struct AiConfig {
+    size_t ttMegabytes; /* transposition table size, kept across moves */
+    int maxDepth;
+    unsigned int timeMs;
+    uint64_t nodeLimit;
+    int threads;        /* including the main search thread, 0 means 1 */
+    int ponder;         /* let checkersAiPonderAsync search on the opponent's time */
+    const char* tablebasePath; /* directory of tools/tbgen files, NULL or missing for none */
+    const char* bookPath;   /* tools/bookgen file, NULL or missing for none */
+    void (*onIteration)(void* context, const struct AiLine* line);
+    void* context;
+};
+
 struct Ai;
 
 struct Ai* checkersAiCreate(struct Checkers* gameboard);
+struct Ai* checkersAiCreateEx(struct Checkers* gameboard, const struct AiConfig* config);
 int checkersAiGenMovesAsync(struct Ai* ai);
+int checkersAiPonderAsync(struct Ai* ai);
 struct AiMoves checkersAiGenMovesSync(struct Ai* ai);
 struct AiMoves checkersAiTryGetMoves(struct Ai* ai);
+void checkersAiStop(struct Ai* ai);
+int checkersAiGetTtStats(struct Ai* ai, struct TtStats* out);
+int checkersAiGetPv(struct Ai* ai, struct AiLine* out);
+int checkersAiGetStats(struct Ai* ai, struct AiStats* out);
+void checkersAiSetLimits(struct Ai* ai, int maxDepth, unsigned int timeMs, uint64_t nodeLimit);
 void checkersAiKill(struct Ai* ai);
 
 #endif /* CHECKERS_AI_H */
\ No newline at end of file
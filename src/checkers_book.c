@@ -0,0 +1,159 @@
+#include "checkers_book.h"
+#include "checkers.h"
+#include "checkers_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BOOK_MAGIC      "CKBK"
+#define BOOK_VERSION    1
+
+struct BookHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t boardSize;
+    uint32_t forceCapture;
+    uint64_t entries;
+};
+
+struct Book {
+    const struct BookEntry* entries;
+    size_t size;
+    struct MappedFile mapped;
+};
+
+struct Book* bookOpen(const char* path, int forceCapture) {
+    if (!path) {
+        return NULL;
+    }
+    struct Book* book = calloc(1, sizeof(struct Book));
+    if (!book) {
+        return NULL;
+    }
+    if (!mapFileOpen(&book->mapped, path) || book->mapped.size < sizeof(struct BookHeader)) {
+        mapFileClose(&book->mapped);
+        free(book);
+        return NULL;
+    }
+    struct BookHeader header;
+    memcpy(&header, book->mapped.data, sizeof(header));
+    int valid = memcmp(header.magic, BOOK_MAGIC, 4) == 0 && header.version == BOOK_VERSION
+        && header.boardSize == CHECKERS_BOARD_SIZE && (int) header.forceCapture == (forceCapture != 0)
+        && header.entries <= (book->mapped.size - sizeof(header)) / sizeof(struct BookEntry);
+    if (!valid) {
+        mapFileClose(&book->mapped);
+        free(book);
+        return NULL;
+    }
+    // the header is a multiple of 8 bytes, so the records stay aligned in the mapping
+    book->entries = (const struct BookEntry*) ((const uint8_t*) book->mapped.data + sizeof(header));
+    book->size = (size_t) header.entries;
+    return book;
+}
+
+void bookClose(struct Book* book) {
+    if (!book) {
+        return;
+    }
+    mapFileClose(&book->mapped);
+    free(book);
+}
+
+size_t bookFind(struct Book* book, uint64_t key, const struct BookEntry** first) {
+    if (!book) {
+        return 0;
+    }
+    size_t lo = 0, hi = book->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (book->entries[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t end = lo;
+    while (end < book->size && book->entries[end].key == key) {
+        end++;
+    }
+    if (first) {
+        *first = book->entries + lo;
+    }
+    return end - lo;
+}
+
+int bookPick(struct Book* book, struct Board* gameboard, uint32_t random, struct Move* out) {
+    if (!gameboard || !out) {
+        return 0;
+    }
+    const struct BookEntry* first;
+    size_t size = bookFind(book, gameboard->hash, &first);
+    uint64_t total = 0;
+    for (size_t i = 0; i < size; i++) {
+        total += first[i].weight;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = random % total;
+    size_t i = 0;
+    while (target >= first[i].weight) {
+        target -= first[i].weight;
+        i++;
+    }
+    *out = (struct Move){
+        .from = first[i].from,
+        .to = first[i].to,
+        .captured = CHECKERS_NO_SQUARE
+    };
+    return 1;
+}
+
+const struct BookEntry* bookEntries(struct Book* book, size_t* size) {
+    if (size) {
+        *size = book ? book->size : 0;
+    }
+    return book ? book->entries : NULL;
+}
+
+static int compareEntries(const void* a, const void* b) {
+    const struct BookEntry* x = a;
+    const struct BookEntry* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->from * 256 + x->to) - (y->from * 256 + y->to);
+}
+
+int bookWriteFile(const char* path, int forceCapture, struct BookEntry* entries, size_t size) {
+    if (!path || (!entries && size)) {
+        return 0;
+    }
+    qsort(entries, size, sizeof(struct BookEntry), compareEntries);
+    size_t merged = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (merged > 0 && compareEntries(&entries[merged - 1], &entries[i]) == 0) {
+            uint64_t weight = (uint64_t) entries[merged - 1].weight + entries[i].weight;
+            entries[merged - 1].weight = weight > UINT32_MAX ? UINT32_MAX : (uint32_t) weight;
+        } else {
+            entries[merged] = entries[i];
+            memset(entries[merged].reserved, 0, sizeof(entries[merged].reserved));
+            merged++;
+        }
+    }
+    struct BookHeader header = {
+        .magic = BOOK_MAGIC,
+        .version = BOOK_VERSION,
+        .boardSize = CHECKERS_BOARD_SIZE,
+        .forceCapture = forceCapture != 0,
+        .entries = merged
+    };
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(entries, sizeof(struct BookEntry), merged, file) == merged;
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,32 @@
+#ifndef CHECKERS_BOOK_H
+#define CHECKERS_BOOK_H
+
+#include "checkers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Opening book: a header followed by BookEntry records sorted by key, one per
+ * move known in a position, so a lookup is a binary search straight into the
+ * mapped file. Keys are struct Board hashes, which include the side to move,
+ * and moves are single hops like the rest of the engine; tools/bookgen.c
+ * writes them.
+ */
+struct BookEntry {
+    uint64_t key;
+    uint32_t weight;    /* how often the move was chosen, picks are proportional to it */
+    uint8_t from, to;   /* bitboard squares */
+    uint8_t reserved[2];
+};
+
+struct Book;
+
+struct Book* bookOpen(const char* path, int forceCapture); /* NULL if the file is missing or built for other rules */
+void bookClose(struct Book* book);
+size_t bookFind(struct Book* book, uint64_t key, const struct BookEntry** first); /* number of entries for key */
+int bookPick(struct Book* book, struct Board* gameboard, uint32_t random, struct Move* out); /* 0 if the position is not in the book */
+const struct BookEntry* bookEntries(struct Book* book, size_t* size);
+int bookWriteFile(const char* path, int forceCapture, struct BookEntry* entries, size_t size); /* sorts entries and merges duplicates */
+
+#endif /* CHECKERS_BOOK_H */
@@ -0,0 +1,147 @@
+#include "checkers_eval.h"
+#include "checkers.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EVAL_X86 1
+#include <immintrin.h>
+#endif
+
+/* the board's table padded to 64 squares, zero on the ghost bits, so a vector never needs a bounds check */
+#define EVAL_LANES 64
+
+typedef void (*EvalKernel)(const struct Board* boards, size_t count, int32_t* out);
+
+/* kernel is stored last, with release, so a caller that sees it also sees the table and the name */
+static int32_t table[4][EVAL_LANES] __attribute__((aligned(32)));
+static const char* kernelName = "none";
+static _Atomic(EvalKernel) kernel = NULL;
+static atomic_int initStarted = 0;
+
+static void evalScalar(const struct Board* boards, size_t count, int32_t* out) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t eval = 0;
+        for (int kind = 0; kind < 4; kind++) {
+            uint64_t bits = boards[i].pieces[kind] & CHECKERS_BOARD_MASK;
+            while (bits) {
+                eval += table[kind][__builtin_ctzll(bits)];
+                bits &= bits - 1;
+            }
+        }
+        out[i] = eval;
+    }
+}
+
+#ifdef EVAL_X86
+
+/**
+ * Both kernels turn each half of a bitboard into per-lane masks by comparing
+ * (half & 1 << lane) with 1 << lane, and add the table lanes the mask keeps.
+ * Ghost and off-board lanes hold zero, so no bits need clearing.
+ */
+__attribute__((target("avx2")))
+static void evalAvx2(const struct Board* boards, size_t count, int32_t* out) {
+    const __m256i laneBits[4] = {
+        _mm256_setr_epi32(1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7),
+        _mm256_setr_epi32(1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15),
+        _mm256_setr_epi32(1 << 16, 1 << 17, 1 << 18, 1 << 19, 1 << 20, 1 << 21, 1 << 22, 1 << 23),
+        _mm256_setr_epi32(1 << 24, 1 << 25, 1 << 26, 1 << 27, 1 << 28, 1 << 29, 1 << 30, (int) (1U << 31))
+    };
+    for (size_t i = 0; i < count; i++) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int kind = 0; kind < 4; kind++) {
+            uint64_t bits = boards[i].pieces[kind];
+            for (int half = 0; half < 2; half++) {
+                __m256i word = _mm256_set1_epi32((int) (uint32_t) (bits >> (half * 32)));
+                for (int v = 0; v < 4; v++) {
+                    __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(word, laneBits[v]), laneBits[v]);
+                    __m256i values = _mm256_load_si256((const __m256i*) &table[kind][half * 32 + v * 8]);
+                    acc = _mm256_add_epi32(acc, _mm256_and_si256(mask, values));
+                }
+            }
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        out[i] = _mm_cvtsi128_si32(sum);
+    }
+}
+
+__attribute__((target("sse2")))
+static void evalSse2(const struct Board* boards, size_t count, int32_t* out) {
+    __m128i laneBits[8];
+    for (int v = 0; v < 8; v++) {
+        laneBits[v] = _mm_setr_epi32((int) (1U << (v * 4)), (int) (1U << (v * 4 + 1)), (int) (1U << (v * 4 + 2)), (int) (1U << (v * 4 + 3)));
+    }
+    for (size_t i = 0; i < count; i++) {
+        __m128i acc = _mm_setzero_si128();
+        for (int kind = 0; kind < 4; kind++) {
+            uint64_t bits = boards[i].pieces[kind];
+            for (int half = 0; half < 2; half++) {
+                __m128i word = _mm_set1_epi32((int) (uint32_t) (bits >> (half * 32)));
+                for (int v = 0; v < 8; v++) {
+                    __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(word, laneBits[v]), laneBits[v]);
+                    __m128i values = _mm_load_si128((const __m128i*) &table[kind][half * 32 + v * 4]);
+                    acc = _mm_add_epi32(acc, _mm_and_si128(mask, values));
+                }
+            }
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        out[i] = _mm_cvtsi128_si32(acc);
+    }
+}
+
+#endif /* EVAL_X86 */
+
+static void evalInit(void) {
+    for (int kind = 0; kind < 4; kind++) {
+        for (int square = 0; square < EVAL_LANES; square++) {
+            int onBoard = square < CHECKERS_SQUARE_BITS && ((CHECKERS_BOARD_MASK >> square) & 1);
+            table[kind][square] = onBoard ? boardSquareScore(kind, square) : 0;
+        }
+    }
+    EvalKernel chosen = evalScalar;
+    kernelName = "scalar";
+    #ifdef EVAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        chosen = evalAvx2;
+        kernelName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        chosen = evalSse2;
+        kernelName = "sse2";
+    }
+    #endif
+    atomic_store_explicit(&kernel, chosen, memory_order_release);
+}
+
+/* the first caller fills the table, any other caller that comes meanwhile waits for it */
+static EvalKernel evalKernel(void) {
+    EvalKernel current = atomic_load_explicit(&kernel, memory_order_acquire);
+    if (current) {
+        return current;
+    }
+    int started = 0;
+    if (atomic_compare_exchange_strong(&initStarted, &started, 1)) {
+        evalInit();
+    }
+    while (!(current = atomic_load_explicit(&kernel, memory_order_acquire))) {
+        // a few hundred table entries, it is over in microseconds
+    }
+    return current;
+}
+
+void evalBatch(const struct Board* boards, size_t count, int32_t* out) {
+    if (!boards || !out) {
+        return;
+    }
+    evalKernel()(boards, count, out);
+}
+
+const char* evalKernelName(void) {
+    evalKernel();
+    return kernelName;
+}
@@ -0,0 +1,19 @@
+#ifndef CHECKERS_EVAL_H
+#define CHECKERS_EVAL_H
+
+#include "checkers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * From-scratch piece-square evaluation of many positions at once: out[i] is what
+ * boardComputeEval(&boards[i]) returns, i.e. the sum struct Board eval keeps
+ * incrementally. Meant for tools that build positions straight from bitboards;
+ * the search reads the incremental field instead. The kernel is picked on first
+ * use, AVX2 or SSE2 when the CPU has them, plain C otherwise.
+ */
+void evalBatch(const struct Board* boards, size_t count, int32_t* out);
+const char* evalKernelName(void);
+
+#endif /* CHECKERS_EVAL_H */
@@ -0,0 +1,68 @@
+#include "checkers_map.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+int mapFileOpen(struct MappedFile* mapped, const char* path) {
+    if (!mapped || !path) {
+        return 0;
+    }
+    memset(mapped, 0, sizeof(struct MappedFile));
+    #ifdef _WIN32
+    mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0
+        || (mapped->map = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL)) == NULL) {
+        CloseHandle(mapped->file);
+        return 0;
+    }
+    mapped->data = MapViewOfFile(mapped->map, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped->data) {
+        CloseHandle(mapped->map);
+        CloseHandle(mapped->file);
+        return 0;
+    }
+    mapped->size = (size_t) size.QuadPart;
+    #else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    mapped->data = data;
+    mapped->size = (size_t) st.st_size;
+    #endif
+    return 1;
+}
+
+void mapFileClose(struct MappedFile* mapped) {
+    if (!mapped || !mapped->data) {
+        return;
+    }
+    #ifdef _WIN32
+    UnmapViewOfFile(mapped->data);
+    CloseHandle(mapped->map);
+    CloseHandle(mapped->file);
+    #else
+    munmap((void*) mapped->data, mapped->size);
+    #endif
+    memset(mapped, 0, sizeof(struct MappedFile));
+}
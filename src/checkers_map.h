@@ -0,0 +1,24 @@
+#ifndef CHECKERS_MAP_H
+#define CHECKERS_MAP_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/* a whole file mapped read-only, for the tablebase and opening book readers */
+struct MappedFile {
+    const void* data;   /* NULL when nothing is mapped */
+    size_t size;
+    #ifdef _WIN32
+    HANDLE file;
+    HANDLE map;
+    #endif
+};
+
+int mapFileOpen(struct MappedFile* mapped, const char* path);
+void mapFileClose(struct MappedFile* mapped);
+
+#endif /* CHECKERS_MAP_H */
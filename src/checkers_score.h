@@ -0,0 +1,34 @@
+#ifndef CHECKERS_SCORE_H
+#define CHECKERS_SCORE_H
+
+#include "checkers.h"
+
+#include <stdint.h>
+
+/**
+ * Search scores are fixed point, in CHECKERS_EVAL_SCALE units of the evaluation,
+ * from the point of view of the side to move. A side that cannot move has lost;
+ * losing in n plies scores -(AI_SCORE_WIN - n), so shorter wins score higher and
+ * anything beyond AI_SCORE_WIN_BOUND is a forced result rather than an evaluation.
+ */
+typedef int32_t aiscore;
+
+#define AI_SCORE_MAX_PLY        1024
+#define AI_SCORE_WIN            30000000
+#define AI_SCORE_WIN_BOUND      (AI_SCORE_WIN - AI_SCORE_MAX_PLY)
+#define AI_SCORE_INFINITE       (AI_SCORE_WIN + 1)
+
+static inline int aiScoreIsDecided(aiscore score) {
+    return score >= AI_SCORE_WIN_BOUND || score <= -AI_SCORE_WIN_BOUND;
+}
+
+/* the table keeps win and loss scores as distances from the stored node, not from the root */
+static inline aiscore aiScoreToTt(aiscore score, int ply) {
+    return score >= AI_SCORE_WIN_BOUND ? score + ply : score <= -AI_SCORE_WIN_BOUND ? score - ply : score;
+}
+
+static inline aiscore aiScoreFromTt(aiscore score, int ply) {
+    return score >= AI_SCORE_WIN_BOUND ? score - ply : score <= -AI_SCORE_WIN_BOUND ? score + ply : score;
+}
+
+#endif /* CHECKERS_SCORE_H */
@@ -0,0 +1,262 @@
+#include "checkers_tb.h"
+#include "checkers.h"
+#include "checkers_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TB_MAGIC    "CKTB"
+#define TB_VERSION  2
+
+struct TbHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t boardSize;
+    uint32_t forceCapture;
+    uint32_t counts[4];     /* light men, light kings, dark men, dark kings */
+    uint64_t positions;     /* per side to move */
+};
+
+struct TbFile {
+    const uint8_t* values;  /* after the header, NULL if the file is missing */
+    uint64_t positions;
+    struct MappedFile mapped;
+};
+
+#define TB_SIDE         (TB_MAX_PIECES + 1)
+#define TB_SIGNATURES   (TB_SIDE * TB_SIDE * TB_SIDE * TB_SIDE)
+
+struct Tablebase {
+    struct TbFile files[TB_SIDE][TB_SIDE][TB_SIDE][TB_SIDE];
+    int maxPieces;
+    int forceCapture;
+};
+
+#define TB_SQUARES (CHECKERS_BOARD_SIZE * CHECKERS_HALF_SIZE)
+
+/* playable squares numbered from 0 without the ghost bits, squareOf mapping them back, and binomials over them */
+static uint8_t denseOf[64];
+static uint8_t squareOf[TB_SQUARES];
+static uint64_t binomial[65][TB_MAX_PIECES + 1];
+static uint64_t menForbidden[2];
+static int tablesReady = 0;
+
+static void tablesInit(void) {
+    if (tablesReady) {
+        return;
+    }
+    int dense = 0;
+    for (int square = 0; square < 64; square++) {
+        if (square < CHECKERS_SQUARE_BITS && ((CHECKERS_BOARD_MASK >> square) & 1)) {
+            squareOf[dense] = square;
+            denseOf[square] = dense++;
+            struct Point pos = boardPointFromSquare(square);
+            if (pos.y == 0) {
+                menForbidden[CHECKERS_PLAYER_ONE] |= 1ULL << square;
+            } else if (pos.y == CHECKERS_BOARD_SIZE - 1) {
+                menForbidden[CHECKERS_PLAYER_TWO] |= 1ULL << square;
+            }
+        }
+    }
+    for (int n = 0; n <= 64; n++) {
+        binomial[n][0] = 1;
+        for (int k = 1; k <= TB_MAX_PIECES; k++) {
+            binomial[n][k] = n == 0 ? 0 : binomial[n - 1][k - 1] + binomial[n - 1][k];
+        }
+    }
+    tablesReady = 1;
+}
+
+/* colex rank of a set of squares among all C(TB_SQUARES, k) sets of that size */
+static inline uint64_t rankSquares(uint64_t bits) {
+    uint64_t rank = 0;
+    for (int i = 1; bits; i++) {
+        rank += binomial[denseOf[__builtin_ctzll(bits)]][i];
+        bits &= bits - 1;
+    }
+    return rank;
+}
+
+static inline uint64_t unrankSquares(uint64_t rank, int count) {
+    uint64_t bits = 0;
+    int x = TB_SQUARES - 1;
+    for (int i = count; i >= 1; i--) {
+        while (binomial[x][i] > rank) {
+            x--;
+        }
+        rank -= binomial[x][i];
+        bits |= 1ULL << squareOf[x];
+        x--;
+    }
+    return bits;
+}
+
+uint64_t tbSignatureSize(const int counts[4]) {
+    tablesInit();
+    uint64_t size = 1;
+    for (int kind = 0; kind < 4; kind++) {
+        size *= binomial[TB_SQUARES][counts[kind]];
+    }
+    return size;
+}
+
+void tbSignature(struct Board* gameboard, int counts[4]) {
+    for (int kind = 0; kind < 4; kind++) {
+        counts[kind] = __builtin_popcountll(gameboard->pieces[kind]);
+    }
+}
+
+/* mixed radix over the four piece kinds, light men most significant */
+uint64_t tbIndex(struct Board* gameboard) {
+    tablesInit();
+    uint64_t index = 0;
+    for (int kind = 0; kind < 4; kind++) {
+        int count = __builtin_popcountll(gameboard->pieces[kind]);
+        index = index * binomial[TB_SQUARES][count] + rankSquares(gameboard->pieces[kind]);
+    }
+    return index;
+}
+
+int tbUnindex(const int counts[4], uint64_t index, uint64_t pieces[4]) {
+    tablesInit();
+    uint64_t seen = 0;
+    for (int kind = 3; kind >= 0; kind--) {
+        uint64_t radix = binomial[TB_SQUARES][counts[kind]];
+        pieces[kind] = unrankSquares(index % radix, counts[kind]);
+        index /= radix;
+        if (pieces[kind] & seen) {
+            return 0;
+        }
+        seen |= pieces[kind];
+    }
+    // a man on its promotion row would have been crowned
+    return !(pieces[PIECE_LIGHT_MAN] & menForbidden[CHECKERS_PLAYER_ONE]) && !(pieces[PIECE_DARK_MAN] & menForbidden[CHECKERS_PLAYER_TWO]);
+}
+
+int tbFileName(char* out, size_t size, const char* directory, const int counts[4]) {
+    int written = snprintf(out, size, "%s/tb%d%d%d%d.ctb", directory, counts[0], counts[1], counts[2], counts[3]);
+    return written > 0 && (size_t) written < size;
+}
+
+int tbWriteFile(const char* path, const int counts[4], int forceCapture, const uint8_t* values) {
+    struct TbHeader header = {
+        .magic = TB_MAGIC,
+        .version = TB_VERSION,
+        .boardSize = CHECKERS_BOARD_SIZE,
+        .forceCapture = forceCapture != 0,
+        .counts = { counts[0], counts[1], counts[2], counts[3] },
+        .positions = tbSignatureSize(counts)
+    };
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(values, 1, header.positions * 2, file) == header.positions * 2;
+    return fclose(file) == 0 && ok;
+}
+
+static int openFile(struct Tablebase* tb, const char* directory, const int counts[4]) {
+    char path[1024];
+    struct TbFile* tbFile = &tb->files[counts[0]][counts[1]][counts[2]][counts[3]];
+    if (!tbFileName(path, sizeof(path), directory, counts) || !mapFileOpen(&tbFile->mapped, path)) {
+        return 0;
+    }
+    struct TbHeader header;
+    uint64_t positions = tbSignatureSize(counts);
+    if (tbFile->mapped.size < sizeof(header)) {
+        mapFileClose(&tbFile->mapped);
+        return 0;
+    }
+    memcpy(&header, tbFile->mapped.data, sizeof(header));
+    int valid = memcmp(header.magic, TB_MAGIC, 4) == 0 && header.version == TB_VERSION
+        && header.boardSize == CHECKERS_BOARD_SIZE && (int) header.forceCapture == tb->forceCapture
+        && header.positions == positions && tbFile->mapped.size >= sizeof(header) + positions * 2;
+    for (int kind = 0; kind < 4; kind++) {
+        valid = valid && (int) header.counts[kind] == counts[kind];
+    }
+    if (!valid) {
+        mapFileClose(&tbFile->mapped);
+        return 0;
+    }
+    tbFile->values = (const uint8_t*) tbFile->mapped.data + sizeof(header);
+    tbFile->positions = positions;
+    return 1;
+}
+
+/* maps every signature found in directory; files built for the other capture rule are skipped */
+struct Tablebase* tbOpen(const char* directory, int forceCapture) {
+    if (!directory) {
+        return NULL;
+    }
+    tablesInit();
+    struct Tablebase* tb = calloc(1, sizeof(struct Tablebase));
+    if (!tb) {
+        return NULL;
+    }
+    tb->forceCapture = forceCapture != 0;
+    int found = 0;
+    for (int signature = 0; signature < TB_SIGNATURES; signature++) {
+        int counts[4] = {
+            signature / (TB_SIDE * TB_SIDE * TB_SIDE),
+            signature / (TB_SIDE * TB_SIDE) % TB_SIDE,
+            signature / TB_SIDE % TB_SIDE,
+            signature % TB_SIDE
+        };
+        int total = counts[0] + counts[1] + counts[2] + counts[3];
+        if (total > TB_MAX_PIECES || counts[0] + counts[1] == 0 || counts[2] + counts[3] == 0 || !openFile(tb, directory, counts)) {
+            continue;
+        }
+        found += 1;
+        if (total > tb->maxPieces) {
+            tb->maxPieces = total;
+        }
+    }
+    if (!found) {
+        free(tb);
+        return NULL;
+    }
+    return tb;
+}
+
+void tbClose(struct Tablebase* tb) {
+    if (!tb) {
+        return;
+    }
+    struct TbFile* files = &tb->files[0][0][0][0];
+    for (int signature = 0; signature < TB_SIGNATURES; signature++) {
+        mapFileClose(&files[signature].mapped);
+    }
+    free(tb);
+}
+
+int tbMaxPieces(struct Tablebase* tb) {
+    return tb ? tb->maxPieces : 0;
+}
+
+int tbProbe(struct Tablebase* tb, struct Board* gameboard, int* distance) {
+    if (!tb || !gameboard || gameboard->remainingLightPieces + gameboard->remainingDarkPieces > tb->maxPieces) {
+        return TB_UNKNOWN;
+    }
+    int counts[4];
+    tbSignature(gameboard, counts);
+    struct TbFile* tbFile = &tb->files[counts[0]][counts[1]][counts[2]][counts[3]];
+    if (!tbFile->values) {
+        return TB_UNKNOWN;
+    }
+    uint8_t value = tbFile->values[gameboard->sideToMove * tbFile->positions + tbIndex(gameboard)];
+    if (value == TB_VALUE_INVALID) {
+        return TB_UNKNOWN;
+    }
+    if (value == TB_VALUE_DRAW) {
+        if (distance) {
+            *distance = 0;
+        }
+        return TB_DRAW;
+    }
+    if (distance) {
+        *distance = value - 1;
+    }
+    return (value - 1) % 2 == 0 ? TB_LOSS : TB_WIN;
+}
@@ -0,0 +1,42 @@
+#ifndef CHECKERS_TB_H
+#define CHECKERS_TB_H
+
+#define TB_MAX_PIECES       8
+#define TB_DRAW             0
+#define TB_WIN              1
+#define TB_LOSS             2
+#define TB_UNKNOWN          -1
+
+/* one byte per position: 0 is a draw, otherwise distance + 1 where an even distance is a loss */
+#define TB_VALUE_DRAW       0
+#define TB_VALUE_INVALID    0xFF
+#define TB_MAX_DISTANCE     0xFD
+
+#include "checkers.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Endgame tablebases: one file per material signature (light men, light kings,
+ * dark men, dark kings), solved under the rules the search plays by, i.e.
+ * boardGenerateMoves and boardMakeChainedMove, where a ply is a whole turn.
+ * A file holds a value for every index of both sides to move; tools/tbgen.c
+ * writes them.
+ */
+struct Tablebase;
+
+struct Tablebase* tbOpen(const char* directory, int forceCapture); /* NULL if no file matches */
+void tbClose(struct Tablebase* tb);
+int tbMaxPieces(struct Tablebase* tb);
+int tbProbe(struct Tablebase* tb, struct Board* gameboard, int* distance); /* TB_WIN, TB_LOSS, TB_DRAW or TB_UNKNOWN, distance in plies */
+
+/* indexing, shared by the generator and the probing code */
+uint64_t tbSignatureSize(const int counts[4]); /* indices per side to move */
+uint64_t tbIndex(struct Board* gameboard);
+int tbUnindex(const int counts[4], uint64_t index, uint64_t pieces[4]); /* 0 if the index is not a legal position */
+void tbSignature(struct Board* gameboard, int counts[4]);
+int tbFileName(char* out, size_t size, const char* directory, const int counts[4]);
+int tbWriteFile(const char* path, const int counts[4], int forceCapture, const uint8_t* values); /* values for both sides, side to move major */
+
+#endif /* CHECKERS_TB_H */
@@ -0,0 +1,213 @@
+#include "checkers_trace.h"
+
+#ifdef CHECKERS_TRACE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+/* the allocators are named in parentheses below so the macros of the header leave them alone */
+
+#define TRACE_DEFAULT_FILE "checkers_trace.json"
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    int64_t value;  /* allocations during a span, the value of a counter */
+    char phase;     /* 'X' for a span, 'C' for a counter, as the trace format has it */
+};
+
+/* written by the thread that holds it only; head counts every event ever written */
+struct TraceRing {
+    atomic_int used;
+    int id;
+    char name[32];
+    _Atomic uint64_t head;
+    struct TraceEvent events[TRACE_RING_EVENTS];
+};
+
+static struct TraceRing* _Atomic rings[TRACE_MAX_THREADS];
+static atomic_int ringsSize;
+static atomic_int dumpRegistered;
+static _Thread_local struct TraceRing* threadRing;
+static _Thread_local int threadRingless;    /* no ring was left for the thread, it records nothing */
+static _Thread_local uint64_t threadAllocations;
+
+static uint64_t traceNow(void) {
+    #ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000 + (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    #endif
+}
+
+static void dumpAtExit(void) {
+    const char* path = getenv("CHECKERS_TRACE_FILE");
+    if (!path || !*path) {
+        path = TRACE_DEFAULT_FILE;
+    }
+    if (!traceDump(path)) {
+        fprintf(stderr, "cannot write the trace to %s\n", path);
+    }
+}
+
+/* a ring some thread gave back, or a new one */
+static struct TraceRing* claimRing(const char* name) {
+    struct TraceRing* ring = NULL;
+    int size = atomic_load(&ringsSize);
+    size = size < TRACE_MAX_THREADS ? size : TRACE_MAX_THREADS;
+    for (int i = 0; i < size && !ring; i++) {
+        struct TraceRing* candidate = atomic_load(&rings[i]);
+        int unused = 0;
+        if (candidate && atomic_compare_exchange_strong(&candidate->used, &unused, 1)) {
+            ring = candidate;
+        }
+    }
+    if (!ring) {
+        int id = atomic_fetch_add(&ringsSize, 1);
+        if (id >= TRACE_MAX_THREADS || !(ring = (calloc)(1, sizeof(struct TraceRing)))) {
+            return NULL;
+        }
+        ring->id = id;
+        atomic_store(&ring->used, 1);
+        atomic_store(&rings[id], ring);
+    }
+    if (name) {
+        snprintf(ring->name, sizeof(ring->name), "%s", name);
+    } else {
+        snprintf(ring->name, sizeof(ring->name), "thread %d", ring->id);
+    }
+    int registered = 0;
+    if (atomic_compare_exchange_strong(&dumpRegistered, &registered, 1)) {
+        atexit(dumpAtExit);
+    }
+    return ring;
+}
+
+static void record(const char* name, char phase, uint64_t start, uint64_t duration, int64_t value) {
+    if (!threadRing && !threadRingless) {
+        threadRing = claimRing(NULL);
+        threadRingless = threadRing == NULL;
+    }
+    struct TraceRing* ring = threadRing;
+    if (!ring) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->events[head & (TRACE_RING_EVENTS - 1)] = (struct TraceEvent){
+        .name = name,
+        .start = start,
+        .duration = duration,
+        .value = value,
+        .phase = phase
+    };
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+struct TraceSpan traceBegin(const char* name) {
+    return (struct TraceSpan){
+        .name = name,
+        .start = traceNow(),
+        .allocations = threadAllocations
+    };
+}
+
+void traceEnd(struct TraceSpan* span) {
+    uint64_t now = traceNow();
+    record(span->name, 'X', span->start, now - span->start, (int64_t) (threadAllocations - span->allocations));
+}
+
+void traceCounter(const char* name, int64_t value) {
+    record(name, 'C', traceNow(), 0, value);
+}
+
+void traceThreadBegin(const char* name) {
+    traceThreadEnd();
+    threadRing = claimRing(name);
+    threadRingless = threadRing == NULL;
+}
+
+/* the events stay in the ring for the dump, the next thread to claim it writes after them */
+void traceThreadEnd(void) {
+    if (threadRing) {
+        atomic_store(&threadRing->used, 0);
+        threadRing = NULL;
+    }
+}
+
+/* meant for when the traced threads are done; events a thread overwrites meanwhile can come out torn */
+int traceDump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return 0;
+    }
+    int size = atomic_load(&ringsSize);
+    size = size < TRACE_MAX_THREADS ? size : TRACE_MAX_THREADS;
+    uint64_t heads[TRACE_MAX_THREADS];
+    uint64_t epoch = UINT64_MAX;
+    for (int i = 0; i < size; i++) {
+        struct TraceRing* ring = atomic_load(&rings[i]);
+        heads[i] = ring ? atomic_load_explicit(&ring->head, memory_order_acquire) : 0;
+        uint64_t first = heads[i] > TRACE_RING_EVENTS ? heads[i] - TRACE_RING_EVENTS : 0;
+        for (uint64_t k = first; k < heads[i]; k++) {
+            uint64_t start = ring->events[k & (TRACE_RING_EVENTS - 1)].start;
+            epoch = start < epoch ? start : epoch;
+        }
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char* separator = "";
+    for (int i = 0; i < size; i++) {
+        struct TraceRing* ring = atomic_load(&rings[i]);
+        if (!ring) {
+            continue;
+        }
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator, ring->id, ring->name);
+        separator = ",\n";
+        uint64_t first = heads[i] > TRACE_RING_EVENTS ? heads[i] - TRACE_RING_EVENTS : 0;
+        for (uint64_t k = first; k < heads[i]; k++) {
+            const struct TraceEvent* event = &ring->events[k & (TRACE_RING_EVENTS - 1)];
+            double ts = (event->start - epoch) / 1000.0;
+            if (event->phase == 'X') {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"allocations\":%lld}}",
+                    event->name, ring->id, ts, event->duration / 1000.0, (long long) event->value);
+            } else {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                    event->name, ring->id, ts, (long long) event->value);
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+void* traceMalloc(size_t size) {
+    threadAllocations += 1;
+    return (malloc)(size);
+}
+
+void* traceCalloc(size_t count, size_t size) {
+    threadAllocations += 1;
+    return (calloc)(count, size);
+}
+
+void* traceRealloc(void* pointer, size_t size) {
+    threadAllocations += 1;
+    return (realloc)(pointer, size);
+}
+
+#endif /* CHECKERS_TRACE */
@@ -0,0 +1,69 @@
+#ifndef CHECKERS_TRACE_H
+#define CHECKERS_TRACE_H
+
+/**
+ * Opt-in instrumentation, built with -DCHECKERS_TRACE ('make TRACE=1'); without
+ * it every macro below expands to nothing and the build is unchanged.
+ *
+ * TRACE_SCOPE("name") times the rest of the enclosing block as a span, and
+ * also notes how many malloc, calloc and realloc calls the thread made while
+ * it ran, which files that include this header last count for them.
+ * TRACE_COUNTER records a value at a point in time. Every thread writes its
+ * events to a ring of its own, where the newest TRACE_RING_EVENTS are kept,
+ * without locks; at exit all the rings are written as a Chrome trace
+ * (chrome://tracing, Perfetto) to $CHECKERS_TRACE_FILE, checkers_trace.json
+ * by default.
+ *
+ * Threads that come and go, like the search helpers, bracket themselves with
+ * TRACE_THREAD_BEGIN and TRACE_THREAD_END so their rings are reused; any
+ * other thread gets one the first time it records something.
+ */
+#ifdef CHECKERS_TRACE
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS   (1 << 18)   /* a power of two */
+#endif
+#define TRACE_MAX_THREADS   256
+
+struct TraceSpan {
+    const char* name;
+    uint64_t start;         /* nanoseconds on the monotonic clock */
+    uint64_t allocations;   /* of the thread when the span began */
+};
+
+struct TraceSpan traceBegin(const char* name);
+void traceEnd(struct TraceSpan* span);
+void traceCounter(const char* name, int64_t value);
+void traceThreadBegin(const char* name);
+void traceThreadEnd(void);
+int traceDump(const char* path);
+
+void* traceMalloc(size_t size);
+void* traceCalloc(size_t count, size_t size);
+void* traceRealloc(void* pointer, size_t size);
+
+#define TRACE_CONCAT_(a, b)         a##b
+#define TRACE_CONCAT(a, b)          TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)           struct TraceSpan TRACE_CONCAT(traceSpan, __LINE__) __attribute__((cleanup(traceEnd))) = traceBegin(name)
+#define TRACE_COUNTER(name, value)  traceCounter(name, value)
+#define TRACE_THREAD_BEGIN(name)    traceThreadBegin(name)
+#define TRACE_THREAD_END()          traceThreadEnd()
+
+#define malloc(size)                traceMalloc(size)
+#define calloc(count, size)         traceCalloc(count, size)
+#define realloc(pointer, size)      traceRealloc(pointer, size)
+
+#else
+
+#define TRACE_SCOPE(name)           ((void) 0)
+#define TRACE_COUNTER(name, value)  ((void) 0)
+#define TRACE_THREAD_BEGIN(name)    ((void) 0)
+#define TRACE_THREAD_END()          ((void) 0)
+
+#endif /* CHECKERS_TRACE */
+
+#endif /* CHECKERS_TRACE_H */
@@ -0,0 +1,197 @@
+#include "checkers_tt.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * check holds key ^ data, so a slot only matches its key when both words come
+ * from the same store. data packs, from the low byte up: best.from, best.to,
+ * depth, bound in the low two bits and age in the upper six, then the score.
+ * Four slots fill one 64 byte cache line.
+ */
+struct TtSlot {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+};
+
+struct TtCluster {
+    struct TtSlot slots[TT_CLUSTER_SIZE];
+};
+
+#define TT_AGE_MASK     0x3F
+
+struct TranspositionTable {
+    void* memory;
+    struct TtCluster* clusters; /* memory aligned to a cache line */
+    size_t mask;
+    _Atomic uint8_t generation;
+    _Atomic uint64_t probes;
+    _Atomic uint64_t hits;
+    _Atomic uint64_t stores;
+    _Atomic uint64_t replacements;
+};
+
+static inline uint64_t packData(struct Move best, int depth, int bound, int age, aiscore score) {
+    return (uint64_t) best.from | (uint64_t) best.to << 8 | (uint64_t) (uint8_t) depth << 16
+        | (uint64_t) (bound | (age & TT_AGE_MASK) << 2) << 24 | (uint64_t) (uint32_t) score << 32;
+}
+
+static inline int dataDepth(uint64_t data) { return (int8_t) (data >> 16); }
+static inline int dataAge(uint64_t data) { return (data >> 26) & TT_AGE_MASK; }
+
+/* a consistent copy of the slot, or 0 if it holds a different key or was torn */
+static inline int readSlot(struct TtSlot* slot, uint64_t key, uint64_t* data) {
+    *data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    uint64_t check = atomic_load_explicit(&slot->check, memory_order_relaxed);
+    return (check ^ *data) == key;
+}
+
+static inline void writeSlot(struct TtSlot* slot, uint64_t key, uint64_t data) {
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->check, key ^ data, memory_order_relaxed);
+}
+
+static inline int currentAge(struct TranspositionTable* tt) {
+    return atomic_load_explicit(&tt->generation, memory_order_relaxed) & TT_AGE_MASK;
+}
+
+/* how many searches ago the slot was written, wraps around after 64 */
+static inline int slotAge(struct TranspositionTable* tt, uint64_t data) {
+    return (currentAge(tt) - dataAge(data)) & TT_AGE_MASK;
+}
+
+struct TranspositionTable* ttCreate(size_t megabytes) {
+    size_t bytes = megabytes * 1024 * 1024;
+    size_t count = 1;
+    while (count * 2 * sizeof(struct TtCluster) <= bytes) {
+        count *= 2;
+    }
+    struct TranspositionTable* tt = calloc(1, sizeof(struct TranspositionTable));
+    if (!tt) {
+        return NULL;
+    }
+    tt->memory = calloc(count + 1, sizeof(struct TtCluster));
+    if (!tt->memory) {
+        free(tt);
+        return NULL;
+    }
+    tt->clusters = (struct TtCluster*) (((uintptr_t) tt->memory + 63) & ~(uintptr_t) 63);
+    tt->mask = count - 1;
+    return tt;
+}
+
+void ttDestroy(struct TranspositionTable* tt) {
+    if (tt) {
+        free(tt->memory);
+        free(tt);
+    }
+}
+
+/* not safe while a search is running */
+void ttClear(struct TranspositionTable* tt) {
+    if (tt) {
+        memset(tt->clusters, 0, (tt->mask + 1) * sizeof(struct TtCluster));
+        atomic_store(&tt->generation, 0);
+        atomic_store(&tt->probes, 0);
+        atomic_store(&tt->hits, 0);
+        atomic_store(&tt->stores, 0);
+        atomic_store(&tt->replacements, 0);
+    }
+}
+
+void ttNewSearch(struct TranspositionTable* tt) {
+    if (tt) {
+        atomic_fetch_add(&tt->generation, 1);
+    }
+}
+
+int ttProbe(struct TranspositionTable* tt, uint64_t key, struct TtEntry* out) {
+    struct TtCluster* cluster = &tt->clusters[key & tt->mask];
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++) {
+        uint64_t data;
+        if (key == 0 || !readSlot(&cluster->slots[i], key, &data)) {
+            continue;
+        }
+        // refresh the age so the entry survives this search
+        int age = currentAge(tt);
+        if (dataAge(data) != age) {
+            data = (data & ~((uint64_t) TT_AGE_MASK << 26)) | (uint64_t) age << 26;
+            writeSlot(&cluster->slots[i], key, data);
+        }
+        *out = (struct TtEntry){
+            .key = key,
+            .score = (aiscore) (uint32_t) (data >> 32),
+            .best = { .from = data & 0xFF, .to = (data >> 8) & 0xFF, .captured = CHECKERS_NO_SQUARE },
+            .depth = dataDepth(data),
+            .bound = (data >> 24) & 0x3,
+            .age = age
+        };
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Same position: overwritten, keeping the old best move if the new one has none.
+ * Otherwise the victim is the slot with the lowest depth, where every search
+ * since it was last touched counts as two plies lost, so stale deep entries
+ * eventually make room.
+ */
+int ttStore(struct TranspositionTable* tt, uint64_t key, int depth, aiscore score, int bound, struct Move best) {
+    struct TtCluster* cluster = &tt->clusters[key & tt->mask];
+    struct TtSlot* victim = &cluster->slots[0];
+    int victimWorth = 0x7FFFFFFF;
+    int evicts = 0;
+    for (int i = 0; i < TT_CLUSTER_SIZE; i++) {
+        struct TtSlot* slot = &cluster->slots[i];
+        uint64_t old;
+        if (readSlot(slot, key, &old)) {
+            if (best.from == best.to) {
+                best.from = old & 0xFF;
+                best.to = (old >> 8) & 0xFF;
+            }
+            victim = slot;
+            evicts = 0;
+            break;
+        }
+        int empty = atomic_load_explicit(&slot->check, memory_order_relaxed) == 0;
+        int worth = empty ? -0x7FFFFFFF : dataDepth(old) - 2 * slotAge(tt, old);
+        if (worth < victimWorth) {
+            victimWorth = worth;
+            victim = slot;
+            evicts = !empty;
+        }
+    }
+    writeSlot(victim, key, packData(best, depth, bound, currentAge(tt), score));
+    return evicts;
+}
+
+void ttAddStats(struct TranspositionTable* tt, const struct TtStats* counters) {
+    if (!tt || !counters) {
+        return;
+    }
+    atomic_fetch_add_explicit(&tt->probes, counters->probes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tt->hits, counters->hits, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tt->stores, counters->stores, memory_order_relaxed);
+    atomic_fetch_add_explicit(&tt->replacements, counters->replacements, memory_order_relaxed);
+}
+
+void ttGetStats(struct TranspositionTable* tt, struct TtStats* out) {
+    if (!tt || !out) {
+        return;
+    }
+    out->probes = atomic_load_explicit(&tt->probes, memory_order_relaxed);
+    out->hits = atomic_load_explicit(&tt->hits, memory_order_relaxed);
+    out->stores = atomic_load_explicit(&tt->stores, memory_order_relaxed);
+    out->replacements = atomic_load_explicit(&tt->replacements, memory_order_relaxed);
+    out->capacity = (tt->mask + 1) * TT_CLUSTER_SIZE;
+    size_t sample = tt->mask + 1 < 1000 ? tt->mask + 1 : 1000;
+    size_t used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        for (int j = 0; j < TT_CLUSTER_SIZE; j++) {
+            used += atomic_load_explicit(&tt->clusters[i].slots[j].check, memory_order_relaxed) != 0;
+        }
+    }
+    out->used = used * (tt->mask + 1) / sample;
+}
@@ -0,0 +1,51 @@
+#ifndef CHECKERS_TT_H
+#define CHECKERS_TT_H
+
+#define TT_BOUND_EXACT      0
+#define TT_BOUND_LOWER      1 /* score is at least this, the search failed high */
+#define TT_BOUND_UPPER      2 /* score is at most this, the search failed low */
+
+#define TT_CLUSTER_SIZE     4
+
+#include "checkers.h"
+#include "checkers_score.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct TtEntry {
+    uint64_t key;
+    aiscore score;      /* wins and losses counted from this node, see aiScoreToTt */
+    struct Move best;   /* from == to when there is none, captured is not kept */
+    int8_t depth;
+    uint8_t bound;
+    uint8_t age;
+};
+
+struct TtStats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t stores;
+    uint64_t replacements; /* stores that evicted a different position */
+    size_t capacity;       /* entries */
+    size_t used;           /* estimated from a sample of the table */
+};
+
+/**
+ * The table may be shared by several search threads without locking: a slot
+ * torn by two concurrent writers fails its key check and reads as a miss.
+ * Probes and stores do not count themselves, each thread keeps its own
+ * counters and adds them with ttAddStats, so no cache line is shared for them.
+ */
+struct TranspositionTable;
+
+struct TranspositionTable* ttCreate(size_t megabytes);
+void ttDestroy(struct TranspositionTable* tt);
+void ttClear(struct TranspositionTable* tt);
+void ttNewSearch(struct TranspositionTable* tt);
+int ttProbe(struct TranspositionTable* tt, uint64_t key, struct TtEntry* out);
+int ttStore(struct TranspositionTable* tt, uint64_t key, int depth, aiscore score, int bound, struct Move best); /* returns 1 if another position was evicted */
+void ttAddStats(struct TranspositionTable* tt, const struct TtStats* counters);
+void ttGetStats(struct TranspositionTable* tt, struct TtStats* out);
+
+#endif /* CHECKERS_TT_H */
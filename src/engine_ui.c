@@ -0,0 +1,566 @@
+#include "engine_ui.h"
+#include "checkers.h"
+#include "checkers_ai.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+
+typedef uintptr_t uithread;
+typedef CRITICAL_SECTION uimutex;
+#define THREAD_RETURN unsigned __stdcall
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_t uithread;
+typedef pthread_mutex_t uimutex;
+#define THREAD_RETURN void*
+
+#endif
+
+/* last, so its allocator macros stay out of the system headers */
+#include "checkers_trace.h"
+
+#define ENGINE_NAME     "checkers"
+#define ENGINE_VERSION  "1.0"
+#define LINE_SIZE       8192
+#define VALUE_SIZE      1024
+#define TURN_SIZE       (CHECKERS_PIECES_AMOUNT * 4 + 8)
+#define MAX_HOPS        (CHECKERS_PIECES_AMOUNT + 1)
+
+struct Engine {
+    struct Checkers* game;      /* the position pos set up, which the Ai plays on */
+    struct Ai* ai;
+    struct AiConfig config;
+    int reload;                 /* a param changed since the Ai was created */
+    char bookPath[VALUE_SIZE];
+    char tablebasePath[VALUE_SIZE];
+
+    // level, 0 for none
+    int depth;
+    uint64_t nodes;
+    double moveTime;
+    double clockTime, increment;
+    int movesToGo;
+    int infinite;
+
+    int searching;              /* a search thread was started and is not joined yet */
+    int analyze;
+    int reporting;              /* only the search of the first hop sends info lines */
+    atomic_int stopRequested;
+    atomic_int finished;        /* the search thread has sent its done line */
+    struct Board root;
+    double searchStart;
+    uithread tid;
+
+    FILE* out;
+    uimutex outMutex;
+};
+
+static void send(struct Engine* engine, const char* format, ...);
+static int findArgument(const char* args, const char* key, char* out, size_t size);
+static int playTurnText(struct Checkers* game, const char* text);
+static void stopSearch(struct Engine* engine);
+static int startSearch(struct Engine* engine, int analyze);
+static int loadEngine(struct Engine* engine);
+static inline double wallSeconds(void);
+static inline void sleepMs(unsigned int ms);
+
+void engineProtocolBegin(struct Checkers* game, FILE* in, FILE* out) {
+    struct Engine engine = {
+        .game = game,
+        .reload = 1,
+        .out = out
+    };
+    engine.config = (struct AiConfig){
+        .ttMegabytes = AI_DEFAULT_TT_MEGABYTES,
+        .maxDepth = AI_MAX_DEPTH,
+        .timeMs = AI_DEFAULT_TIME_MS,
+        .threads = 1
+    };
+    snprintf(engine.bookPath, sizeof(engine.bookPath), "%s", AI_DEFAULT_BOOK_PATH);
+    snprintf(engine.tablebasePath, sizeof(engine.tablebasePath), "%s", AI_DEFAULT_TABLEBASE_PATH);
+    #ifdef _WIN32
+    InitializeCriticalSection(&engine.outMutex);
+    #else
+    pthread_mutex_init(&engine.outMutex, NULL);
+    #endif
+
+    char line[LINE_SIZE];
+    char value[VALUE_SIZE];
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* args = line + strcspn(line, " \t");
+        if (*args) {
+            *args++ = '\0';
+        }
+        const char* command = line;
+        if (command[0] == '\0') {
+            continue;
+        }
+        if (strcmp(command, "hub") == 0) {
+            send(&engine, "id name=%s version=%s\n", ENGINE_NAME, ENGINE_VERSION);
+            send(&engine, "param name=threads value=%d type=int min=1 max=%d\n", engine.config.threads, AI_MAX_THREADS);
+            send(&engine, "param name=tt-size value=%zu type=int min=1 max=65536\n", engine.config.ttMegabytes);
+            send(&engine, "param name=book value=\"%s\" type=string\n", engine.bookPath);
+            send(&engine, "param name=tablebases value=\"%s\" type=string\n", engine.tablebasePath);
+            send(&engine, "param name=capture value=%s type=enum values=\"forced free\"\n", game->flags.forceCapture ? "forced" : "free");
+            send(&engine, "wait\n");
+        } else if (strcmp(command, "init") == 0) {
+            stopSearch(&engine);
+            if (loadEngine(&engine)) {
+                send(&engine, "ready\n");
+            }
+        } else if (strcmp(command, "set-param") == 0) {
+            char name[64];
+            if (!findArgument(args, "name", name, sizeof(name)) || !findArgument(args, "value", value, sizeof(value))) {
+                send(&engine, "error message=\"set-param needs name and value\"\n");
+                continue;
+            }
+            stopSearch(&engine);
+            if (strcmp(name, "threads") == 0) {
+                engine.config.threads = atoi(value);
+            } else if (strcmp(name, "tt-size") == 0) {
+                engine.config.ttMegabytes = (size_t) atoi(value);
+            } else if (strcmp(name, "book") == 0) {
+                snprintf(engine.bookPath, sizeof(engine.bookPath), "%s", value);
+            } else if (strcmp(name, "tablebases") == 0) {
+                snprintf(engine.tablebasePath, sizeof(engine.tablebasePath), "%s", value);
+            } else if (strcmp(name, "capture") == 0 && (strcmp(value, "forced") == 0 || strcmp(value, "free") == 0)) {
+                game->flags.forceCapture = strcmp(value, "forced") == 0;
+            } else {
+                send(&engine, "error message=\"unknown param %s or value %s\"\n", name, value);
+                continue;
+            }
+            engine.reload = 1;
+        } else if (strcmp(command, "new-game") == 0) {
+            stopSearch(&engine);
+            checkersInit(game, game->flags.forceCapture, 0);
+            engine.reload = 1;
+        } else if (strcmp(command, "pos") == 0) {
+            stopSearch(&engine);
+            checkersInit(game, game->flags.forceCapture, 0);
+            if (findArgument(args, "fen", value, sizeof(value))) {
+                if (!boardLoadFen(&game->checkersBoard, value)) {
+                    send(&engine, "error message=\"bad fen %s\"\n", value);
+                    checkersInit(game, game->flags.forceCapture, 0);
+                    continue;
+                }
+                game->state = game->checkersBoard.sideToMove == CHECKERS_PLAYER_ONE ? CSTATE_P1_TURN : CSTATE_P2_TURN;
+            }
+            char moves[LINE_SIZE];
+            if (findArgument(args, "moves", moves, sizeof(moves))) {
+                for (char* token = strtok(moves, " "); token; token = strtok(NULL, " ")) {
+                    if (!playTurnText(game, token)) {
+                        send(&engine, "error message=\"illegal move %s\"\n", token);
+                        break;
+                    }
+                }
+            }
+        } else if (strcmp(command, "level") == 0) {
+            stopSearch(&engine);
+            engine.depth = findArgument(args, "depth", value, sizeof(value)) ? atoi(value) : 0;
+            engine.nodes = findArgument(args, "nodes", value, sizeof(value)) ? strtoull(value, NULL, 10) : 0;
+            engine.moveTime = findArgument(args, "move-time", value, sizeof(value)) ? atof(value) : 0.0;
+            engine.clockTime = findArgument(args, "time", value, sizeof(value)) ? atof(value) : 0.0;
+            engine.increment = findArgument(args, "inc", value, sizeof(value)) ? atof(value) : 0.0;
+            engine.movesToGo = findArgument(args, "moves", value, sizeof(value)) ? atoi(value) : 0;
+            engine.infinite = findArgument(args, "infinite", value, sizeof(value));
+        } else if (strcmp(command, "go") == 0) {
+            int analyze = strncmp(args, "analyze", 7) == 0;
+            if (!analyze && strncmp(args, "think", 5) != 0) {
+                send(&engine, "error message=\"go takes think or analyze\"\n");
+                continue;
+            }
+            stopSearch(&engine);
+            if (loadEngine(&engine)) {
+                startSearch(&engine, analyze);
+            }
+        } else if (strcmp(command, "stop") == 0) {
+            stopSearch(&engine);
+        } else if (strcmp(command, "ping") == 0) {
+            send(&engine, "pong\n");
+        } else if (strcmp(command, "quit") == 0) {
+            break;
+        } else {
+            send(&engine, "error message=\"unknown command %s\"\n", command);
+        }
+    }
+    stopSearch(&engine);
+    checkersAiKill(engine.ai);
+    #ifdef _WIN32
+    DeleteCriticalSection(&engine.outMutex);
+    #else
+    pthread_mutex_destroy(&engine.outMutex);
+    #endif
+}
+
+/* whole lines only, so the search thread and the command loop never interleave */
+static void send(struct Engine* engine, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    #ifdef _WIN32
+    EnterCriticalSection(&engine->outMutex);
+    #else
+    pthread_mutex_lock(&engine->outMutex);
+    #endif
+    vfprintf(engine->out, format, args);
+    fflush(engine->out);
+    #ifdef _WIN32
+    LeaveCriticalSection(&engine->outMutex);
+    #else
+    pthread_mutex_unlock(&engine->outMutex);
+    #endif
+    va_end(args);
+}
+
+/* key=value, key="quoted value" or a bare key, which has an empty value; 0 if key is not there */
+static int findArgument(const char* args, const char* key, char* out, size_t size) {
+    const char* p = args;
+    size_t keyLength = strlen(key);
+    while (*p) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        const char* name = p;
+        while (*p && *p != '=' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        size_t nameLength = (size_t) (p - name);
+        const char* value = p;
+        size_t valueLength = 0;
+        if (*p == '=') {
+            p++;
+            if (*p == '"') {
+                value = ++p;
+                while (*p && *p != '"') {
+                    p++;
+                }
+                valueLength = (size_t) (p - value);
+                if (*p) {
+                    p++;
+                }
+            } else {
+                value = p;
+                while (*p && *p != ' ' && *p != '\t') {
+                    p++;
+                }
+                valueLength = (size_t) (p - value);
+            }
+        }
+        if (nameLength > 0 && nameLength == keyLength && strncmp(name, key, keyLength) == 0) {
+            if (valueLength >= size) {
+                valueLength = size - 1;
+            }
+            memcpy(out, value, valueLength);
+            out[valueLength] = '\0';
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Plays the rest of a capture of the mover from square from, hop by hop,
+ * through the landing squares in squares[next..count) in order, backing out of
+ * wrong turns; the capture has to end on the last of them.
+ */
+static int playCapture(struct Checkers* game, int player, int from, const int* squares, int count, int next) {
+    if (checkersGetCurrentPlayer(game) != player) {
+        return next == count && from == squares[count - 1];
+    }
+    struct MoveList moves;
+    checkersGenerateMoves(game, &moves);
+    for (size_t i = 0; i < moves.size; i++) {
+        struct Move move = moves.moves[i];
+        if (move.from != from || move.captured == CHECKERS_NO_SQUARE) {
+            continue;
+        }
+        struct CheckersUndo undo;
+        if (checkersMakeMoveUndoable(game, boardPointFromSquare(move.from), boardPointFromSquare(move.to), &undo) != CHECKERS_CAPTURE_SUCCESS) {
+            continue;
+        }
+        int reached = next < count && move.to == squares[next] ? next + 1 : next;
+        if (playCapture(game, player, move.to, squares, count, reached)) {
+            return 1;
+        }
+        checkersUndoMove(game, &undo);
+    }
+    return 0;
+}
+
+/* one whole turn, "32-28", "19x28" or "19x28x37"; 0 if it is not legal here */
+static int playTurnText(struct Checkers* game, const char* text) {
+    int squares[MAX_HOPS + 1];
+    int count = 0;
+    int capture = strchr(text, 'x') != NULL || strchr(text, 'X') != NULL;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long number = strtol(p, &end, 10);
+        int square = end == p ? -1 : boardSquareFromNumber((int) number);
+        if (square < 0 || count == MAX_HOPS + 1) {
+            return 0;
+        }
+        squares[count++] = square;
+        p = end;
+        if (*p == '-' || *p == 'x' || *p == 'X') {
+            p++;
+        } else if (*p) {
+            return 0;
+        }
+    }
+    int player = checkersGetCurrentPlayer(game);
+    if (count < 2 || player < 0) {
+        return 0;
+    }
+    if (capture) {
+        return playCapture(game, player, squares[0], squares, count, 1);
+    }
+    struct MoveList moves;
+    checkersGenerateMoves(game, &moves);
+    int index = checkersFindMove(&moves, boardPointFromSquare(squares[0]), boardPointFromSquare(squares[1]));
+    if (count != 2 || index < 0 || moves.moves[index].captured != CHECKERS_NO_SQUARE) {
+        return 0;
+    }
+    return checkersMakeMove(game, boardPointFromSquare(squares[0]), boardPointFromSquare(squares[1])) == CHECKERS_MOVE_SUCCESS;
+}
+
+/* the legal hop from the AI's points, continuing the capture of the piece on chain unless it is -1 */
+static int findHop(struct Board* board, int chain, int forceCapture, struct AiMoves hop, struct Move* out) {
+    struct MoveList moves;
+    if (chain >= 0) {
+        boardGenerateChainMoves(board, chain, forceCapture, &moves);
+    } else {
+        boardGenerateMoves(board, board->sideToMove, forceCapture, &moves);
+    }
+    int index = checkersFindMove(&moves, hop.from, hop.to);
+    if (index < 0) {
+        return 0;
+    }
+    *out = moves.moves[index];
+    return 1;
+}
+
+/* adds move to text, which holds the turn so far; a new turn starts with its square and a space before it */
+static void appendHop(char* text, size_t size, struct Move move, int newTurn) {
+    size_t length = strlen(text);
+    if (newTurn) {
+        snprintf(text + length, size - length, "%s%d", length ? " " : "", boardNumberFromSquare(move.from));
+        length = strlen(text);
+    }
+    snprintf(text + length, size - length, "%c%d", move.captured != CHECKERS_NO_SQUARE ? 'x' : '-', boardNumberFromSquare(move.to));
+}
+
+/* the hops of line from first on, as whole turns, while they are legal on board */
+static void formatLine(struct Board board, int forceCapture, const struct AiLine* line, int first, char* text, size_t size) {
+    text[0] = '\0';
+    int chain = -1;
+    for (int i = first; i < line->size; i++) {
+        struct Move move;
+        if (!findHop(&board, chain, forceCapture, line->moves[i], &move)) {
+            break;
+        }
+        struct MoveUndo undo;
+        boardMakeChainedMove(&board, move, forceCapture, &undo);
+        appendHop(text, size, move, chain < 0);
+        chain = undo.chained ? move.to : -1;
+    }
+}
+
+static void reportIteration(void* context, const struct AiLine* line) {
+    struct Engine* engine = (struct Engine*) context;
+    if (!engine->reporting) {
+        return;
+    }
+    char pv[AI_MAX_PV * 8];
+    formatLine(engine->root, engine->game->flags.forceCapture, line, 0, pv, sizeof(pv));
+    double elapsed = wallSeconds() - engine->searchStart;
+    struct AiStats stats;
+    checkersAiGetStats(engine->ai, &stats);
+    unsigned long long nodes = (unsigned long long) stats.nodes;
+    unsigned long long nps = (unsigned long long) stats.nps;
+    if (aiScoreIsDecided(line->score)) {
+        int plies = AI_SCORE_WIN - (line->score > 0 ? line->score : -line->score);
+        send(engine, "info depth=%d mate=%d time=%.3f nodes=%llu nps=%llu pv=\"%s\"\n",
+            line->depth, line->score > 0 ? plies : -plies, elapsed, nodes, nps, pv);
+    } else {
+        send(engine, "info depth=%d score=%.2f time=%.3f nodes=%llu nps=%llu pv=\"%s\"\n",
+            line->depth, (double) line->score / CHECKERS_EVAL_SCALE, elapsed, nodes, nps, pv);
+    }
+}
+
+/**
+ * The AI answers one hop at a time, so the rest of a multiple capture is taken
+ * from the line of the first hop, and only searched for if the line stops
+ * short and there is time to; a stopped or endless search takes the first
+ * legal hop instead. The Ai's game is put back as pos left it.
+ */
+static THREAD_RETURN runSearch(void* arg) {
+    struct Engine* engine = (struct Engine*) arg;
+    TRACE_THREAD_BEGIN("engine search");
+    struct Checkers* game = engine->game;
+    struct Checkers saved = *game;
+    int forceCapture = game->flags.forceCapture;
+    struct Board board = engine->root;
+
+    engine->reporting = 1;
+    struct AiMoves first = checkersAiGenMovesSync(engine->ai);
+    engine->reporting = 0;
+    struct AiLine line = {0};
+    checkersAiGetPv(engine->ai, &line);
+
+    char move[TURN_SIZE] = "";
+    char ponder[TURN_SIZE] = "";
+    struct Move hop;
+    int hops = 0;
+    if (first.valid && findHop(&board, -1, forceCapture, first, &hop)) {
+        int chain = -1;
+        for (;;) {
+            struct MoveUndo undo;
+            boardMakeChainedMove(&board, hop, forceCapture, &undo);
+            appendHop(move, sizeof(move), hop, chain < 0);
+            hops++;
+            if (!undo.chained) {
+                break;
+            }
+            chain = hop.to;
+            if (hops < line.size && findHop(&board, chain, forceCapture, line.moves[hops], &hop)) {
+                continue;
+            }
+            line.size = 0;
+            struct AiMoves next = { 0 };
+            if (!engine->analyze && !atomic_load(&engine->stopRequested)) {
+                game->checkersBoard = board;
+                next = checkersAiGenMovesSync(engine->ai);
+            }
+            if (!next.valid || !findHop(&board, chain, forceCapture, next, &hop)) {
+                struct MoveList moves;
+                boardGenerateChainMoves(&board, chain, forceCapture, &moves);
+                hop = moves.moves[0];
+            }
+        }
+        formatLine(board, forceCapture, &line, hops, ponder, sizeof(ponder));
+        // only the opponent's next turn
+        ponder[strcspn(ponder, " ")] = '\0';
+    }
+    *game = saved;
+
+    // a stop is what ends an analysis, so it waits for one before it is done
+    while (engine->analyze && !atomic_load(&engine->stopRequested)) {
+        sleepMs(10);
+    }
+    if (move[0] == '\0') {
+        send(engine, "done\n");
+    } else if (ponder[0] == '\0') {
+        send(engine, "done move=%s\n", move);
+    } else {
+        send(engine, "done move=%s ponder=%s\n", move, ponder);
+    }
+    TRACE_THREAD_END();
+    atomic_store(&engine->finished, 1);
+    return 0;
+}
+
+/* creates the Ai again when a param changed, it keeps its table otherwise */
+static int loadEngine(struct Engine* engine) {
+    if (engine->ai && !engine->reload) {
+        return 1;
+    }
+    checkersAiKill(engine->ai);
+    engine->config.bookPath = engine->bookPath[0] ? engine->bookPath : NULL;
+    engine->config.tablebasePath = engine->tablebasePath[0] ? engine->tablebasePath : NULL;
+    engine->config.onIteration = reportIteration;
+    engine->config.context = engine;
+    engine->ai = checkersAiCreateEx(engine->game, &engine->config);
+    if (!engine->ai) {
+        send(engine, "error message=\"cannot create the engine\"\n");
+        return 0;
+    }
+    engine->reload = 0;
+    return 1;
+}
+
+static int startSearch(struct Engine* engine, int analyze) {
+    int depth = engine->depth;
+    uint64_t nodes = engine->nodes;
+    double seconds = AI_DEFAULT_TIME_MS / 1000.0;
+    if (analyze || engine->infinite) {
+        depth = 0;
+        nodes = 0;
+        seconds = 0.0;
+    } else if (engine->moveTime > 0.0) {
+        seconds = engine->moveTime;
+    } else if (engine->clockTime > 0.0) {
+        // a share of what is left, never more than half of it
+        int movesToGo = engine->movesToGo > 0 ? engine->movesToGo : 30;
+        seconds = engine->clockTime / movesToGo + engine->increment;
+        if (seconds > engine->clockTime / 2) {
+            seconds = engine->clockTime / 2;
+        }
+    } else if (depth > 0 || nodes > 0) {
+        seconds = 0.0;
+    }
+    checkersAiSetLimits(engine->ai, depth, (unsigned int) (seconds * 1000.0), nodes);
+
+    engine->root = engine->game->checkersBoard;
+    engine->analyze = analyze;
+    engine->searchStart = wallSeconds();
+    atomic_store(&engine->stopRequested, 0);
+    atomic_store(&engine->finished, 0);
+    #ifdef _WIN32
+    engine->tid = _beginthreadex(NULL, 0, runSearch, engine, 0, NULL);
+    engine->searching = engine->tid != 0;
+    #else
+    engine->searching = pthread_create(&engine->tid, NULL, runSearch, engine) == 0;
+    #endif
+    if (!engine->searching) {
+        send(engine, "error message=\"cannot start the search\"\n");
+    }
+    return engine->searching;
+}
+
+/* stops the search thread, if there is one, and waits for its done line */
+static void stopSearch(struct Engine* engine) {
+    if (!engine->searching) {
+        return;
+    }
+    // a stop that comes before the thread's search has started would be lost, so it is repeated
+    atomic_store(&engine->stopRequested, 1);
+    while (!atomic_load(&engine->finished)) {
+        checkersAiStop(engine->ai);
+        sleepMs(1);
+    }
+    #ifdef _WIN32
+    WaitForSingleObject((HANDLE) engine->tid, INFINITE);
+    CloseHandle((HANDLE) engine->tid);
+    #else
+    pthread_join(engine->tid, NULL);
+    #endif
+    engine->searching = 0;
+}
+
+static inline double wallSeconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static inline void sleepMs(unsigned int ms) {
+    #ifdef _WIN32
+    Sleep(ms);
+    #else
+    nanosleep(&(struct timespec){ .tv_sec = ms / 1000, .tv_nsec = (long) (ms % 1000) * 1000000L }, NULL);
+    #endif
+}
@@ -0,0 +1,32 @@
+#ifndef ENGINE_UI_H
+#define ENGINE_UI_H
+
+#include "checkers.h"
+
+#include <stdio.h>
+
+/**
+ * A headless line protocol in the style of the Hub draughts protocol, for GUIs
+ * and scripts that run the engine as a subprocess. Every line is a command
+ * followed by key=value arguments, values with spaces in double quotes.
+ * Moves are PDN square numbers, "32-28" or "19x28", where a multiple capture
+ * may list its landing squares, "19x28x37", and has to when it is ambiguous.
+ *
+ *   hub                          id, param lines and wait
+ *   init                         (re)creates the engine, ready
+ *   set-param name=n value=v     threads, tt-size (MB), book, tablebases, capture (forced or free)
+ *   new-game                     starts over with an empty table from the initial position
+ *   pos [fen=f] [moves="m ..."]  the initial position or f, then the moves
+ *   level [depth=n] [nodes=n] [move-time=s] [time=s [inc=s] [moves=n]] [infinite]
+ *   go think | go analyze        info lines, then done move=m [ponder=m]; analyze runs until stop
+ *   stop                         the running search ends now with its done line
+ *   ping                         pong
+ *   quit
+ *
+ * While searching, the engine sends an info line with depth, score (or mate,
+ * in plies, negative when losing), time in seconds, nodes, nps and pv for
+ * every completed iteration. Anything it cannot do is answered with error message="...".
+ */
+void engineProtocolBegin(struct Checkers* game, FILE* in, FILE* out);
+
+#endif /* ENGINE_UI_H */
@@ -16,6 +16,7 @@ void guiGameBegin(struct Checkers* game) {
     struct Ai* ai = NULL;
     struct AiMoves aiMove;
     int allowPlayerMove = 1;
+    int pondering = 0;  /* started on the human's turn, once */
     if (game->flags.aiEnabled) {
         ai = checkersAiCreate(game);
     }
@@ -44,12 +45,17 @@ void guiGameBegin(struct Checkers* game) {
     const int gameHeight = 800;
     RenderTexture2D gameScreen = LoadRenderTexture(gameWidth, gameHeight);
 
-    int boardQuadSize = gameWidth / game->checkersBoard.boardSize;
+    int boardQuadSize = gameWidth / CHECKERS_BOARD_SIZE;
     int moveIdx = 0;
     struct Point move[2] = {0};
+    struct MoveList available;
     while (!WindowShouldClose()) {
         switch (game->state) {
             case CSTATE_P1_TURN:    
+                if (game->flags.aiEnabled && ai && !pondering) {
+                    checkersAiPonderAsync(ai);
+                    pondering = 1;
+                }
                 if (checkersPlayerShallCapture(game)) {
                     SetWindowTitle("International Checkers - Player one's turn, light pieces. Must capture!!");
                 } else {
@@ -60,6 +66,7 @@ void guiGameBegin(struct Checkers* game) {
                 if (game->flags.aiEnabled && ai) {
                     SetWindowTitle("International Checkers - Player two is thinking...");
                     allowPlayerMove = 0;
+                    pondering = 0;
                     int ok = checkersAiGenMovesAsync(ai);
                     if (!ok) {
                         CloseWindow();
@@ -120,8 +127,8 @@ void guiGameBegin(struct Checkers* game) {
 
         BeginTextureMode(gameScreen);
             ClearBackground(BLACK);
-            for (int i = 0; i < game->checkersBoard.boardSize; i++) {
-                for (int j = 0; j < game->checkersBoard.boardSize; j++) {
+            for (int i = 0; i < CHECKERS_BOARD_SIZE; i++) {
+                for (int j = 0; j < CHECKERS_BOARD_SIZE; j++) {
                     if ((j + i) % 2 == 0) {
                         DrawRectangle(j * boardQuadSize, i * boardQuadSize, boardQuadSize, boardQuadSize, (Color){.r = 232, .g = 208, .b = 170, .a = 255});
                     } else {
@@ -143,6 +150,15 @@ void guiGameBegin(struct Checkers* game) {
             DrawRectangleLinesEx((Rectangle){x * boardQuadSize, y * boardQuadSize, boardQuadSize, boardQuadSize}, 4, checkersGetCurrentPlayer(game) == CHECKERS_PLAYER_ONE ? playerOneColor : playerTwoColor);
             if (moveIdx == 1) {
                 DrawRectangleLinesEx((Rectangle){move[0].x * boardQuadSize, move[0].y * boardQuadSize, boardQuadSize, boardQuadSize}, 4, BLUE);
+                int selected = boardSquareFromPoint(move[0]);
+                checkersGenerateMoves(game, &available);
+                for (size_t i = 0; i < available.size; i++) {
+                    if (available.moves[i].from != selected) {
+                        continue;
+                    }
+                    struct Point to = boardPointFromSquare(available.moves[i].to);
+                    DrawCircle(to.x * boardQuadSize + (boardQuadSize / 2), to.y * boardQuadSize + (boardQuadSize / 2), (float) (boardQuadSize * 0.25f) / 2, Fade(BLUE, .5f));
+                }
             }
         EndTextureMode();
 
@@ -160,7 +176,6 @@ void guiGameBegin(struct Checkers* game) {
     }
 
     if (WindowShouldClose() && game->flags.aiEnabled && ai) {
-        SetWindowTitle("Just a second...");
         checkersAiKill(ai);
     }
     // TODO: Unload all loaded data (textures, fonts, audio) here!
@@ -170,10 +185,10 @@ void guiGameBegin(struct Checkers* game) {
 
 static void handleMove(struct Checkers* game, struct Point move[2]) {
     if (checkersPlayerShallCapture(game)) {
-        struct Checkers future = *game;
-        int status = checkersMakeMove(&future, move[0], move[1]);
-        if (status == CHECKERS_CAPTURE_SUCCESS) {
-            *game = future;
+        struct CheckersUndo undo;
+        int status = checkersMakeMoveUndoable(game, move[0], move[1], &undo);
+        if (status == CHECKERS_MOVE_SUCCESS) {
+            checkersUndoMove(game, &undo);
         }
     } else {
         int status = checkersMakeMove(game, move[0], move[1]);
@@ -10,6 +10,8 @@
 static inline int validateInput(char* input);
 static char* readLine(FILE* file, size_t* out_size);
 static void handleMove(struct Checkers* game, struct Point orig, struct Point dest);
+static void printMoves(struct Checkers* game);
+static void printExpectedLine(struct Ai* ai);
 
 /** 
  * (a-j)(0-9) || (0-9)(0-9)
@@ -39,6 +41,7 @@ void terminalCheckersBeginF(struct Checkers* game, FILE* stepsfile) {
                 if (!moves.valid) {
                     break;
                 }
+                printExpectedLine(ai);
                 handleMove(game, moves.from, moves.to);
                 continue;
             }
@@ -51,8 +54,14 @@ void terminalCheckersBeginF(struct Checkers* game, FILE* stepsfile) {
             move = readLine(stepsfile, &linesize);
             if (strcmp("exit", move) == 0) {
                 free(move);
+                checkersAiKill(ai);
                 return;
             }
+            if (strcmp("moves", move) == 0) {
+                printMoves(game);
+                free(move);
+                continue;
+            }
             if (!validateInput(move)) {
                 printf("Invalid indices\n");
                 free(move);
@@ -87,13 +96,15 @@ void terminalCheckersBeginF(struct Checkers* game, FILE* stepsfile) {
 
 static void handleMove(struct Checkers* game, struct Point orig, struct Point dest) {
     if (checkersPlayerShallCapture(game)) {
-        struct Checkers future = *game;
-        int status = checkersMakeMove(&future, orig, dest);
+        struct CheckersUndo undo;
+        int status = checkersMakeMoveUndoable(game, orig, dest, &undo);
         if (status != CHECKERS_CAPTURE_SUCCESS) {
+            if (status == CHECKERS_MOVE_SUCCESS) {
+                checkersUndoMove(game, &undo);
+            }
             printf("Player shall capture!!\n");
             printf("Capture failed!\n\n");
         } else {
-            *game = future;
             printf("successful capture!\n\n");
         }
     } else {
@@ -115,18 +126,35 @@ static void handleMove(struct Checkers* game, struct Point orig, struct Point de
     }
 }
 
+static void printMoves(struct Checkers* game) {
+    struct MoveList moves;
+    checkersGenerateMoves(game, &moves);
+    printf("Available moves:");
+    for (size_t i = 0; i < moves.size; i++) {
+        struct Point from = boardPointFromSquare(moves.moves[i].from);
+        struct Point to = boardPointFromSquare(moves.moves[i].to);
+        printf(
+            " %c%d %c%d%s",
+            'a' + from.x, CHECKERS_BOARD_SIZE - 1 - from.y,
+            'a' + to.x, CHECKERS_BOARD_SIZE - 1 - to.y,
+            i + 1 < moves.size ? "," : ""
+        );
+    }
+    printf("\n");
+}
+
 /* format: oo dd, o -> origin, a1 or 11, d -> destination, a1 or 11 */
 static inline int validateInput(char* input) {
     return (
         strlen(input) == 5 &&
         input[2] == ' ' &&
         (
-            (isalpha((unsigned char) input[0]) && tolower((unsigned char) input[0]) <= 'j') ||
+            (isalpha((unsigned char) input[0]) && tolower((unsigned char) input[0]) <= 'a' + CHECKERS_BOARD_SIZE - 1) ||
             isdigit((unsigned char) input[0])
         ) &&
         isdigit((unsigned char) input[1]) &&
         (
-            (isalpha((unsigned char) input[3]) && tolower((unsigned char) input[3]) <= 'j') ||
+            (isalpha((unsigned char) input[3]) && tolower((unsigned char) input[3]) <= 'a' + CHECKERS_BOARD_SIZE - 1) ||
             isdigit((unsigned char) input[3])
         ) &&
         isdigit((unsigned char) input[4])
@@ -144,6 +172,31 @@ static struct Point getPositionFromStr(char* pos) {
     };
 }
 
+static void printExpectedLine(struct Ai* ai) {
+    struct AiLine line;
+    if (!checkersAiGetPv(ai, &line)) {
+        return;
+    }
+    if (aiScoreIsDecided(line.score)) {
+        int plies = AI_SCORE_WIN - (line.score > 0 ? line.score : -line.score);
+        printf("Expected line (depth %d, %s in %d):", line.depth, line.score > 0 ? "win" : "loss", plies);
+    } else {
+        printf("Expected line (depth %d, %+.2f):", line.depth, (double) line.score / CHECKERS_EVAL_SCALE);
+    }
+    for (int i = 0; i < line.size; i++) {
+        struct Point from = line.moves[i].from;
+        struct Point to = line.moves[i].to;
+        printf(" %c%d-%c%d", 'a' + from.x, CHECKERS_BOARD_SIZE - 1 - from.y, 'a' + to.x, CHECKERS_BOARD_SIZE - 1 - to.y);
+    }
+    printf("\n");
+    struct AiStats stats;
+    if (checkersAiGetStats(ai, &stats) && stats.nodes > 0) {
+        printf("Searched %llu nodes in %.2fs (%llu nps), selective depth %d, cutoffs %.0f%% (%.0f%% on the first move), table hits %.0f%%\n",
+            (unsigned long long) stats.nodes, stats.elapsedMs / 1000.0, (unsigned long long) stats.nps, stats.selDepth,
+            stats.cutoffRate * 100, stats.firstCutoffRate * 100, stats.ttProbes ? 100.0 * stats.ttHits / stats.ttProbes : 0.0);
+    }
+}
+
 static char* readLine(FILE* file, size_t* out_size) {
     if (file == NULL || out_size == NULL) {
         return NULL;
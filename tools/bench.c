@@ -0,0 +1,309 @@
+#include "checkers.h"
+#include "checkers_ai.h"
+#include "checkers_eval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/**
+ * bench: times the hot functions of the engine on a fixed set of positions,
+ * one set per board size, so two builds can be compared without timing the
+ * GUI by hand.
+ *
+ * Usage: bench [-r runs] [-w runs] [-t ms] [-d depth] [-b name] [-o file]
+ *   -r  timed runs of each benchmark (default 15)
+ *   -w  untimed warm-up runs before them (default 3)
+ *   -t  shortest run, the work of a run is doubled until it takes this long (default 20)
+ *   -d  depth of the search benchmark (default 8)
+ *   -b  only the benchmarks whose name contains this
+ *   -o  also write the results to this file as CSV, one line per benchmark
+ *
+ * Every run goes over all the positions, as many times as the calibration
+ * asked for, and counts one op per call. The median and 95th percentile are
+ * over the runs, in nanoseconds per op, and ops/s is the inverse of the
+ * median. The search benchmark plays a fresh Ai per position and search, so
+ * the table starts empty every time; creating it counts.
+ */
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#define MAX_RUNS        1000
+#define MAX_PASSES      (1ULL << 30)
+
+/* from the start, through opening and middlegame, to endings with kings; captures pending in some */
+#if CHECKERS_BOARD_SIZE == 10
+static const char* positionFens[] = {
+    "W:W31-50:B1-20",
+    "W:W31,33-50:B1-13,15-18,20,23",
+    "B:W26,30,31,33,35,36,40,41,44,45,46,47,48,49,50:B1,2,3,4,5,6,7,8,9,10,11,12,17,19,21,24",
+    "B:W18,26,31,32,34,35,36,37,39,40,42,43,44,45,46,47,48,49,50:B1,2,3,4,5,6,7,8,9,10,12,13,14,15,16,17,20,21",
+    "W:W26,34,36,37,39,42,43,50:B1,5,6,8,11,13,18,21,22,23",
+    "W:W27,28,32,33,38,K10:B13,17,19,23,24,K41",
+    "W:WK3,K28,45:BK40,K46,12"
+};
+#else
+static const char* positionFens[] = {
+    "W:W21-32:B1-12",
+    "W:W21,23,25,26,28,29,30,31,32:B1,3,4,5,7,8,12,13,14",
+    "B:W5,21,22,23,28,29,30,31:B1,3,4,6,8,12,14",
+    "W:W12,17,25,27,28,29,30,31,32:B1,2,3,4,6,8,14",
+    "B:WK10,14,25,26,28,30,32:B3,5,11,12,20",
+    "W:WK1,K22,27:BK11,K29,6"
+};
+#endif
+
+#define POSITIONS (sizeof(positionFens) / sizeof(positionFens[0]))
+
+struct Benchmark {
+    const char* name;
+    uint64_t (*run)(uint64_t passes);   /* returns the ops done */
+};
+
+struct Result {
+    uint64_t opsPerRun;
+    double median;  /* nanoseconds per op */
+    double p95;
+};
+
+static struct Board boards[POSITIONS];
+static struct MoveList moves[POSITIONS];
+static int searchDepth = 8;
+static volatile uint64_t sink;  /* keeps the compiler from dropping work whose result is unused */
+
+static uint64_t nowNs(void) {
+    #ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000 + (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    #endif
+}
+
+static uint64_t runGenerateMoves(uint64_t passes) {
+    uint64_t ops = 0;
+    struct MoveList list;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            sink += boardGenerateMoves(&boards[i], boards[i].sideToMove, 1, &list);
+            ops++;
+        }
+    }
+    return ops;
+}
+
+static uint64_t runCanCapture(uint64_t passes) {
+    uint64_t ops = 0;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            sink += boardCheckIfPlayerCanCapture(&boards[i], CHECKERS_PLAYER_ONE);
+            sink += boardCheckIfPlayerCanCapture(&boards[i], CHECKERS_PLAYER_TWO);
+            ops += 2;
+        }
+    }
+    return ops;
+}
+
+/* every legal hop of every position, each on a fresh copy of the board */
+static uint64_t runTryMoveOrCapture(uint64_t passes) {
+    uint64_t ops = 0;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            for (size_t k = 0; k < moves[i].size; k++) {
+                struct Board board = boards[i];
+                struct Move move = moves[i].moves[k];
+                sink += boardTryMoveOrCapture(&board, board.sideToMove, boardPointFromSquare(move.from), boardPointFromSquare(move.to));
+                ops++;
+            }
+        }
+    }
+    return ops;
+}
+
+/* what the search does instead of boardTryMoveOrCapture, one op per make and unmake */
+static uint64_t runMakeUnmake(uint64_t passes) {
+    uint64_t ops = 0;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            for (size_t k = 0; k < moves[i].size; k++) {
+                struct MoveUndo undo;
+                boardMakeChainedMove(&boards[i], moves[i].moves[k], 1, &undo);
+                sink += boards[i].hash;
+                boardUnmakeMove(&boards[i], &undo);
+                ops++;
+            }
+        }
+    }
+    return ops;
+}
+
+/* the from-scratch evaluation, which the search keeps incrementally and only reads */
+static uint64_t runComputeEval(uint64_t passes) {
+    uint64_t ops = 0;
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            sink += boardComputeEval(&boards[i]);
+            ops++;
+        }
+    }
+    return ops;
+}
+
+static uint64_t runEvalBatch(uint64_t passes) {
+    int32_t out[POSITIONS];
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        evalBatch(boards, POSITIONS, out);
+        sink += out[0];
+    }
+    return passes * POSITIONS;
+}
+
+static uint64_t runSearch(uint64_t passes) {
+    uint64_t ops = 0;
+    struct AiConfig config = {
+        .ttMegabytes = AI_DEFAULT_TT_MEGABYTES,
+        .maxDepth = searchDepth,
+        .threads = 1
+    };
+    for (uint64_t pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < POSITIONS; i++) {
+            if (moves[i].size == 0) {
+                continue;
+            }
+            struct Checkers game;
+            checkersInit(&game, 1, 0);
+            game.checkersBoard = boards[i];
+            struct Ai* ai = checkersAiCreateEx(&game, &config);
+            if (!ai) {
+                continue;
+            }
+            struct AiMoves move = checkersAiGenMovesSync(ai);
+            sink += move.to.x;
+            checkersAiKill(ai);
+            ops++;
+        }
+    }
+    return ops;
+}
+
+static const struct Benchmark benchmarks[] = {
+    { "boardGenerateMoves", runGenerateMoves },
+    { "boardCheckIfPlayerCanCapture", runCanCapture },
+    { "boardTryMoveOrCapture", runTryMoveOrCapture },
+    { "boardMakeChainedMove+boardUnmakeMove", runMakeUnmake },
+    { "boardComputeEval", runComputeEval },
+    { "evalBatch", runEvalBatch },
+    { "search", runSearch }
+};
+
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static void measure(const struct Benchmark* benchmark, int runs, int warmups, uint64_t minimumNs, struct Result* out) {
+    // the passes double until a run lasts long enough for the clock, which warms up too
+    uint64_t passes = 1;
+    for (;;) {
+        uint64_t start = nowNs();
+        benchmark->run(passes);
+        if (nowNs() - start >= minimumNs || passes >= MAX_PASSES) {
+            break;
+        }
+        passes *= 2;
+    }
+    for (int i = 0; i < warmups; i++) {
+        benchmark->run(passes);
+    }
+    double samples[MAX_RUNS];
+    for (int i = 0; i < runs; i++) {
+        uint64_t start = nowNs();
+        uint64_t ops = benchmark->run(passes);
+        uint64_t elapsed = nowNs() - start;
+        out->opsPerRun = ops;
+        samples[i] = ops ? (double) elapsed / ops : 0;
+    }
+    qsort(samples, runs, sizeof(double), compareDoubles);
+    out->median = runs % 2 ? samples[runs / 2] : (samples[runs / 2 - 1] + samples[runs / 2]) / 2;
+    out->p95 = samples[(int) ceil(0.95 * runs) - 1];
+}
+
+int main(int argc, char** argv) {
+    int runs = 15;
+    int warmups = 3;
+    unsigned long minimumMs = 20;
+    const char* filter = NULL;
+    const char* outputPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmups = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            minimumMs = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            searchDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-r runs] [-w runs] [-t ms] [-d depth] [-b name] [-o file]\n", argv[0]);
+            return 1;
+        }
+    }
+    runs = runs < 1 ? 1 : runs > MAX_RUNS ? MAX_RUNS : runs;
+    warmups = warmups < 0 ? 0 : warmups;
+    searchDepth = searchDepth < 1 ? 1 : searchDepth > AI_MAX_DEPTH ? AI_MAX_DEPTH : searchDepth;
+
+    for (size_t i = 0; i < POSITIONS; i++) {
+        if (!boardLoadFen(&boards[i], positionFens[i])) {
+            fprintf(stderr, "invalid position: %s\n", positionFens[i]);
+            return 1;
+        }
+        boardGenerateMoves(&boards[i], boards[i].sideToMove, 1, &moves[i]);
+    }
+    FILE* output = NULL;
+    if (outputPath) {
+        output = fopen(outputPath, "w");
+        if (!output) {
+            fprintf(stderr, "cannot write %s\n", outputPath);
+            return 1;
+        }
+        fprintf(output, "benchmark,ops_per_run,median_ns,p95_ns,ops_per_second,runs\n");
+    }
+
+    printf("%dx%d board, %zu positions, %d runs after %d warm-ups, search depth %d, eval kernel %s\n\n",
+        CHECKERS_BOARD_SIZE, CHECKERS_BOARD_SIZE, POSITIONS, runs, warmups, searchDepth, evalKernelName());
+    printf("%-38s %12s %14s %14s %14s\n", "benchmark", "ops/run", "median ns/op", "p95 ns/op", "ops/s");
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+        if (filter && !strstr(benchmarks[i].name, filter)) {
+            continue;
+        }
+        struct Result result;
+        measure(&benchmarks[i], runs, warmups, (uint64_t) minimumMs * 1000000, &result);
+        double opsPerSecond = result.median > 0 ? 1e9 / result.median : 0;
+        printf("%-38s %12llu %14.1f %14.1f %14.0f\n", benchmarks[i].name,
+            (unsigned long long) result.opsPerRun, result.median, result.p95, opsPerSecond);
+        fflush(stdout);
+        if (output) {
+            fprintf(output, "%s,%llu,%.3f,%.3f,%.0f,%d\n", benchmarks[i].name,
+                (unsigned long long) result.opsPerRun, result.median, result.p95, opsPerSecond, runs);
+        }
+    }
+    if (output && fclose(output) != 0) {
+        fprintf(stderr, "cannot write %s\n", outputPath);
+        return 1;
+    }
+    return 0;
+}
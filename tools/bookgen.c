@@ -0,0 +1,369 @@
+#include "checkers.h"
+#include "checkers_ai.h"
+#include "checkers_book.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * bookgen: builds an opening book for bookOpen from engine self-play, from
+ * imported games, or both.
+ *
+ * Usage: bookgen [-o file] [-i games.pdn]... [-g games] [-p plies] [-r plies]
+ *                [-s seed] [-m ms] [-d depth] [-a] [-n]
+ *   -o  book file to write (default book.ckb)
+ *   -i  PDN games to import, can be repeated; moves are square numbers, "32-28"
+ *       or "19x28", with any landing squares of a multiple capture in between
+ *   -g  self-play games (default 100 without -i, 0 with it)
+ *   -p  plies of each game that go into the book (default 12, at most 1024)
+ *   -r  random plies at the start of a self-play game, not recorded (default 1)
+ *   -s  seed of the random plies, the same seed gives the same ones (default 1)
+ *   -m  search time per self-play move in milliseconds (default 200)
+ *   -d  search depth limit per self-play move (default none)
+ *   -a  add to the entries of an existing book instead of replacing it
+ *   -n  captures are not forced, the AI only uses books built the same way
+ *
+ * Every recorded ply adds 1 to the weight of its move; imported games with a
+ * result only contribute the winner's moves, or both sides' for a draw.
+ */
+
+#define MAX_PLIES   1024
+
+struct Records {
+    struct BookEntry* entries;
+    size_t size, capacity;
+};
+
+static int forceCapture = 1;
+static uint64_t randomState = 1;
+
+/* xorshift, the way selfplay picks its random openings */
+static uint32_t nextRandom(void) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return (uint32_t) (randomState >> 11);
+}
+
+static int addRecord(struct Records* records, uint64_t key, int from, int to) {
+    if (records->size == records->capacity) {
+        size_t capacity = records->capacity ? records->capacity * 2 : 4096;
+        struct BookEntry* entries = realloc(records->entries, capacity * sizeof(struct BookEntry));
+        if (!entries) {
+            return 0;
+        }
+        records->entries = entries;
+        records->capacity = capacity;
+    }
+    records->entries[records->size++] = (struct BookEntry){
+        .key = key,
+        .weight = 1,
+        .from = from,
+        .to = to
+    };
+    return 1;
+}
+
+static int selfPlay(struct Records* records, int games, int plies, int randomPlies, const struct AiConfig* config) {
+    struct Checkers game;
+    checkersInit(&game, forceCapture, 0);
+    struct Ai* ai = checkersAiCreateEx(&game, config);
+    if (!ai) {
+        fprintf(stderr, "cannot create the AI\n");
+        return 0;
+    }
+    for (int g = 0; g < games; g++) {
+        checkersInit(&game, forceCapture, 0);
+        while (game.flags.run && game.turnsTotal < plies) {
+            struct MoveList moves;
+            if (checkersGenerateMoves(&game, &moves) == 0) {
+                break;
+            }
+            int index = -1;
+            if (game.turnsTotal >= randomPlies) {
+                struct AiMoves aiMove = checkersAiGenMovesSync(ai);
+                index = aiMove.valid ? checkersFindMove(&moves, aiMove.from, aiMove.to) : -1;
+            }
+            int record = index >= 0;
+            if (index < 0) {
+                index = (int) (nextRandom() % moves.size);
+            }
+            struct Move move = moves.moves[index];
+            if (record && !addRecord(records, game.checkersBoard.hash, move.from, move.to)) {
+                checkersAiKill(ai);
+                return 0;
+            }
+            if (checkersMakeMove(&game, boardPointFromSquare(move.from), boardPointFromSquare(move.to)) <= 0) {
+                break;
+            }
+        }
+        printf("\rself-play %d/%d, %zu plies recorded", g + 1, games, records->size);
+        fflush(stdout);
+    }
+    printf("\n");
+    checkersAiKill(ai);
+    return 1;
+}
+
+/**
+ * Plays one capture of the mover from square from, hop by hop, through the
+ * landing squares listed in squares[next..count) in order, backtracking out of
+ * wrong turns. The hops are recorded as they go and dropped on the way back.
+ */
+static int playCapture(struct Checkers* game, int player, int from, const int* squares, int count, int next, struct Records* records) {
+    if (checkersGetCurrentPlayer(game) != player) {
+        return next == count;
+    }
+    struct MoveList moves;
+    checkersGenerateMoves(game, &moves);
+    for (size_t i = 0; i < moves.size; i++) {
+        struct Move move = moves.moves[i];
+        if (move.from != from || move.captured == CHECKERS_NO_SQUARE) {
+            continue;
+        }
+        size_t size = records->size;
+        struct CheckersUndo undo;
+        if (!addRecord(records, game->checkersBoard.hash, move.from, move.to)) {
+            return 0;
+        }
+        if (checkersMakeMoveUndoable(game, boardPointFromSquare(move.from), boardPointFromSquare(move.to), &undo) != CHECKERS_CAPTURE_SUCCESS) {
+            records->size = size;
+            continue;
+        }
+        int reached = next < count && move.to == squares[next] ? next + 1 : next;
+        if (playCapture(game, player, move.to, squares, count, reached, records)) {
+            return 1;
+        }
+        checkersUndoMove(game, &undo);
+        records->size = size;
+    }
+    return 0;
+}
+
+/* one move token, "32-28" or "19x28" or "19x28x37"; 0 if it is not legal here */
+static int playToken(struct Checkers* game, const char* token, struct Records* records) {
+    int squares[CHECKERS_PIECES_AMOUNT + 2];
+    int count = 0;
+    int capture = strchr(token, 'x') != NULL || strchr(token, 'X') != NULL;
+    const char* p = token;
+    while (*p) {
+        char* end;
+        long number = strtol(p, &end, 10);
+        int square = end == p ? -1 : boardSquareFromNumber((int) number);
+        if (square < 0 || count == (int) (sizeof(squares) / sizeof(squares[0]))) {
+            return 0;
+        }
+        squares[count++] = square;
+        p = end;
+        if (*p == '-' || *p == 'x' || *p == 'X') {
+            p++;
+        } else if (*p) {
+            return 0;
+        }
+    }
+    if (count < 2) {
+        return 0;
+    }
+    int player = checkersGetCurrentPlayer(game);
+    if (capture) {
+        return playCapture(game, player, squares[0], squares, count, 1, records);
+    }
+    struct MoveList moves;
+    checkersGenerateMoves(game, &moves);
+    int index = checkersFindMove(&moves, boardPointFromSquare(squares[0]), boardPointFromSquare(squares[1]));
+    if (count != 2 || index < 0 || moves.moves[index].captured != CHECKERS_NO_SQUARE) {
+        return 0;
+    }
+    if (!addRecord(records, game->checkersBoard.hash, squares[0], squares[1])) {
+        return 0;
+    }
+    return checkersMakeMove(game, boardPointFromSquare(squares[0]), boardPointFromSquare(squares[1])) == CHECKERS_MOVE_SUCCESS;
+}
+
+/* a game's plies wait in pending with their movers until its result says which to keep */
+static int finishGame(struct Records* records, struct Records* pending, const int* movers, int winner) {
+    for (size_t i = 0; i < pending->size; i++) {
+        if (winner >= 0 && movers[i] != winner) {
+            continue;
+        }
+        struct BookEntry* entry = &pending->entries[i];
+        if (!addRecord(records, entry->key, entry->from, entry->to)) {
+            return 0;
+        }
+    }
+    pending->size = 0;
+    return 1;
+}
+
+static int importGames(struct Records* records, const char* path, int plies) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 0;
+    }
+    struct Records pending = {0};
+    int movers[MAX_PLIES + CHECKERS_PIECES_AMOUNT]; /* a capture can run past the last ply */
+    struct Checkers game;
+    checkersInit(&game, forceCapture, 0);
+    int games = 0, skipped = 0, broken = 0;
+    int ok = 1;
+    char token[128];
+    int ch = fgetc(file);
+    while (ok && ch != EOF) {
+        // tags and comments are skipped whole, everything else is split on whitespace
+        if (ch == '[' || ch == '{') {
+            int close = ch == '[' ? ']' : '}';
+            while (ch != EOF && ch != close) {
+                ch = fgetc(file);
+            }
+            ch = fgetc(file);
+            continue;
+        }
+        if (isspace(ch)) {
+            ch = fgetc(file);
+            continue;
+        }
+        size_t len = 0;
+        while (ch != EOF && !isspace(ch) && ch != '[' && ch != '{') {
+            if (len + 1 < sizeof(token)) {
+                token[len++] = (char) ch;
+            }
+            ch = fgetc(file);
+        }
+        token[len] = '\0';
+
+        int winner = -2;
+        if (strcmp(token, "2-0") == 0 || strcmp(token, "1-0") == 0) {
+            winner = CHECKERS_PLAYER_ONE;
+        } else if (strcmp(token, "0-2") == 0 || strcmp(token, "0-1") == 0) {
+            winner = CHECKERS_PLAYER_TWO;
+        } else if (strcmp(token, "1-1") == 0 || strcmp(token, "*") == 0) {
+            winner = -1;
+        }
+        if (winner != -2) {
+            ok = finishGame(records, &pending, movers, winner);
+            games += 1;
+            broken = 0;
+            checkersInit(&game, forceCapture, 0);
+            continue;
+        }
+        // move numbers, "12." or "12...", and the moves after an unplayable one
+        size_t digits = strspn(token, "0123456789");
+        if (broken || (digits > 0 && token[digits] == '.')) {
+            continue;
+        }
+        int player = checkersGetCurrentPlayer(&game);
+        size_t before = pending.size;
+        if (game.turnsTotal >= plies) {
+            // past the book's depth, the moves only need to be legal
+            struct Records scratch = {0};
+            broken = !playToken(&game, token, &scratch);
+            free(scratch.entries);
+        } else {
+            broken = !playToken(&game, token, &pending);
+        }
+        if (broken) {
+            pending.size = before;
+            skipped += 1;
+            continue;
+        }
+        for (size_t i = before; i < pending.size; i++) {
+            movers[i] = player;
+        }
+    }
+    // a last game without a result keeps both sides' moves
+    ok = ok && finishGame(records, &pending, movers, -1);
+    free(pending.entries);
+    fclose(file);
+    printf("%s: %d games, %d unplayable moves, %zu plies recorded\n", path, games, skipped, records->size);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* output = "book.ckb";
+    const char* imports[64];
+    int importsSize = 0;
+    int games = -1;
+    int plies = 12;
+    int randomPlies = 1;
+    uint64_t seed = 1;
+    int append = 0;
+    struct AiConfig config = {
+        .ttMegabytes = AI_DEFAULT_TT_MEGABYTES,
+        .maxDepth = AI_MAX_DEPTH,
+        .timeMs = 200,
+        .threads = 1,
+        .ponder = 0,
+        .tablebasePath = AI_DEFAULT_TABLEBASE_PATH,
+        .bookPath = NULL
+    };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc && importsSize < 64) {
+            imports[importsSize++] = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            plies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            randomPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            config.timeMs = (unsigned int) atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            config.maxDepth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            append = 1;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            forceCapture = 0;
+        } else {
+            fprintf(stderr, "usage: %s [-o file] [-i games.pdn]... [-g games] [-p plies] [-r plies] [-s seed] [-m ms] [-d depth] [-a] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (plies < 0 || plies > MAX_PLIES) {
+        fprintf(stderr, "plies must be between 0 and %d\n", MAX_PLIES);
+        return 1;
+    }
+    if (games < 0) {
+        games = importsSize > 0 ? 0 : 100;
+    }
+    randomState = seed * 0x9E3779B97F4A7C15ULL | 1;
+
+    struct Records records = {0};
+    if (append) {
+        size_t size;
+        struct Book* book = bookOpen(output, forceCapture);
+        const struct BookEntry* entries = bookEntries(book, &size);
+        for (size_t i = 0; i < size; i++) {
+            if (!addRecord(&records, entries[i].key, entries[i].from, entries[i].to)) {
+                return 1;
+            }
+            records.entries[records.size - 1].weight = entries[i].weight;
+        }
+        bookClose(book);
+    }
+    for (int i = 0; i < importsSize; i++) {
+        if (!importGames(&records, imports[i], plies)) {
+            return 1;
+        }
+    }
+    if (games > 0 && !selfPlay(&records, games, plies, randomPlies, &config)) {
+        return 1;
+    }
+    if (!bookWriteFile(output, forceCapture, records.entries, records.size)) {
+        fprintf(stderr, "cannot write %s\n", output);
+        return 1;
+    }
+    size_t size = 0;
+    struct Book* book = bookOpen(output, forceCapture);
+    bookEntries(book, &size);
+    bookClose(book);
+    printf("%s: %zu moves\n", output, size);
+    free(records.entries);
+    return 0;
+}
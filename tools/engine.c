@@ -0,0 +1,16 @@
+#include "checkers.h"
+#include "engine_ui.h"
+
+#include <stdio.h>
+
+/**
+ * engine: the AI behind the line protocol of engine_ui.h on stdin and stdout,
+ * without raylib, for GUIs and scripts that run it as a subprocess.
+ */
+
+int main(void) {
+    struct Checkers game;
+    checkersInit(&game, 1, 0);
+    engineProtocolBegin(&game, stdin, stdout);
+    return 0;
+}
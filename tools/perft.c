@@ -0,0 +1,306 @@
+#include "checkers.h"
+#include "checkers_eval.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * perft: counts the leaf nodes of the move tree to a given depth, a move being
+ * a whole turn: every hop is played with boardMakeChainedMove and a capture
+ * goes on with boardGenerateChainMoves, the same way the search does.
+ *
+ * Usage: perft [-d depth] [-f fen] [-n] [-D] [-H megabytes] [-c]
+ *   -d  depth to count to, every depth up to it is reported (default 6)
+ *   -f  start position as a PDN FEN string (default: boardInit)
+ *   -n  captures are not forced
+ *   -D  divide: print the count below each root move at the last depth
+ *   -H  cache subtree counts in a hash table of this many megabytes
+ *   -c  check every node against boardGetAvailableMovesForPlayer and
+ *       boardTryMoveOrCapture, every capture hop against the continuation
+ *       rule of checkersMakeMove and boardGetAvailableMovesForPiece, and the
+ *       incremental hash and eval of every child against a full recompute;
+ *       slow, but catches disagreements
+ */
+
+struct PerftEntry {
+    uint64_t key;
+    uint64_t count;
+};
+
+static struct PerftEntry* table = NULL;
+static size_t tableMask = 0;
+static int checkMoves = 0;
+static uint64_t mismatches = 0;
+
+static int compareInts(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+static void reportMismatch(struct Board* gameboard, const char* what) {
+    char fen[512];
+    if (mismatches++ < 10) {
+        boardWriteFen(gameboard, fen, sizeof(fen));
+        printf("mismatch (%s) at %s\n", what, fen);
+    }
+}
+
+/* the old heap-based API and movePiece must agree with the generator and make/unmake */
+static void checkNode(struct Board* gameboard, int forceCapture, struct MoveList* moves) {
+    int player = gameboard->sideToMove;
+    int expected[CHECKERS_MAX_MOVES * 2], generated[CHECKERS_MAX_MOVES];
+    struct Board children[CHECKERS_MAX_MOVES];
+    int32_t evals[CHECKERS_MAX_MOVES];
+    size_t expectedSize = 0;
+    size_t listSize = 0;
+    struct Moves* list = boardGetAvailableMovesForPlayer(gameboard, player, forceCapture, &listSize);
+    int mustCapture = forceCapture && boardCheckIfPlayerCanCapture(gameboard, player);
+    for (size_t i = 0; i < listSize; i++) {
+        for (size_t j = 0; j < list[i].to_size; j++) {
+            struct Board future = *gameboard;
+            int status = boardTryMoveOrCapture(&future, player, list[i].from, list[i].to[j]);
+            if (status <= 0 || (mustCapture && status != CHECKERS_CAPTURE_SUCCESS)) {
+                continue;
+            }
+            expected[expectedSize++] = boardSquareFromPoint(list[i].from) * 256 + boardSquareFromPoint(list[i].to[j]);
+        }
+    }
+    checkersDestroyMovesList(list, listSize);
+
+    for (size_t i = 0; i < moves->size; i++) {
+        struct Move move = moves->moves[i];
+        generated[i] = move.from * 256 + move.to;
+
+        struct Board future = *gameboard;
+        int status = boardTryMoveOrCapture(&future, player, boardPointFromSquare(move.from), boardPointFromSquare(move.to));
+        boardTryTurnKing(&future, boardPointFromSquare(move.to));
+        struct MoveUndo undo;
+        boardMakeMove(gameboard, move, &undo);
+        children[i] = *gameboard;
+        if ((status == CHECKERS_CAPTURE_SUCCESS) != (move.captured != CHECKERS_NO_SQUARE) ||
+            memcmp(future.pieces, gameboard->pieces, sizeof(future.pieces)) != 0 ||
+            future.remainingLightPieces != gameboard->remainingLightPieces ||
+            future.remainingDarkPieces != gameboard->remainingDarkPieces) {
+            boardUnmakeMove(gameboard, &undo);
+            reportMismatch(gameboard, "movePiece");
+            continue;
+        }
+        boardUnmakeMove(gameboard, &undo);
+        if (gameboard->hash != boardComputeHash(gameboard)) {
+            reportMismatch(gameboard, "hash");
+        }
+    }
+    // the children's evals in one batch, the way tools score positions they build
+    evalBatch(children, moves->size, evals);
+    for (size_t i = 0; i < moves->size; i++) {
+        if (evals[i] != children[i].eval) {
+            reportMismatch(&children[i], "eval");
+        }
+    }
+    qsort(expected, expectedSize, sizeof(int), compareInts);
+    qsort(generated, moves->size, sizeof(int), compareInts);
+    if (expectedSize != moves->size || memcmp(expected, generated, sizeof(int) * expectedSize) != 0) {
+        reportMismatch(gameboard, "move list");
+    }
+}
+
+/* a capture hop keeps the turn exactly when checkersMakeMove would, and then offers the captures the old API finds for the piece */
+static void checkChain(struct Board* gameboard, int forceCapture, struct Move move, const struct MoveUndo* undo) {
+    if (move.captured == CHECKERS_NO_SQUARE) {
+        return;
+    }
+    int player = undo->piece >> 1;
+    struct Point to = boardPointFromSquare(move.to);
+    // a crowned piece is judged as the man it was, which is what checkersMakeMove tests before crowning
+    struct Board before = *gameboard;
+    if (undo->promoted) {
+        uint64_t pieces[4];
+        memcpy(pieces, gameboard->pieces, sizeof(pieces));
+        pieces[undo->piece + 1] &= ~(1ULL << move.to);
+        pieces[undo->piece] |= 1ULL << move.to;
+        boardSetPieces(&before, pieces, gameboard->sideToMove);
+    }
+    int goesOn = forceCapture && boardCheckIfPieceCanCapture(&before, player, to);
+    if (goesOn != undo->chained) {
+        reportMismatch(gameboard, "chain");
+        return;
+    }
+    if (!undo->chained) {
+        return;
+    }
+
+    int expected[CHECKERS_MAX_MOVES], generated[CHECKERS_MAX_MOVES];
+    size_t expectedSize = 0;
+    struct Point* targets = NULL;
+    int count = boardGetAvailableMovesForPiece(gameboard, to, &targets, 1);
+    for (int i = 0; i < count; i++) {
+        struct Board future = *gameboard;
+        if (boardTryMoveOrCapture(&future, player, to, targets[i]) == CHECKERS_CAPTURE_SUCCESS) {
+            expected[expectedSize++] = boardSquareFromPoint(targets[i]);
+        }
+    }
+    free(targets);
+
+    struct MoveList moves;
+    boardGenerateChainMoves(gameboard, move.to, forceCapture, &moves);
+    for (size_t i = 0; i < moves.size; i++) {
+        generated[i] = moves.moves[i].from == move.to ? moves.moves[i].to : -1;
+    }
+    qsort(expected, expectedSize, sizeof(int), compareInts);
+    qsort(generated, moves.size, sizeof(int), compareInts);
+    if (expectedSize != moves.size || memcmp(expected, generated, sizeof(int) * expectedSize) != 0) {
+        reportMismatch(gameboard, "chain moves");
+    }
+}
+
+/* a capture made of several hops is one move, so several leaves can follow a single capture hop */
+static inline int allQuiet(const struct MoveList* moves) {
+    for (size_t i = 0; i < moves->size; i++) {
+        if (moves->moves[i].captured != CHECKERS_NO_SQUARE) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* chain is the square of a piece in the middle of a capture, which is all that may move, -1 otherwise */
+static uint64_t perft(struct Board* gameboard, int forceCapture, int depth, int chain) {
+    struct MoveList moves;
+    if (chain >= 0) {
+        boardGenerateChainMoves(gameboard, chain, forceCapture, &moves);
+    } else {
+        boardGenerateMoves(gameboard, gameboard->sideToMove, forceCapture, &moves);
+    }
+    if (checkMoves && chain < 0) {
+        checkNode(gameboard, forceCapture, &moves);
+    }
+    if (depth == 1 && !checkMoves && allQuiet(&moves)) {
+        return moves.size;
+    }
+
+    // mid-capture entries get keys of their own, like the search's nodeKey
+    uint64_t key = gameboard->hash ^ ((uint64_t) depth * 0x9E3779B97F4A7C15ULL) ^ ((uint64_t) (chain + 1) * 0xC2B2AE3D27D4EB4FULL);
+    struct PerftEntry* entry = table ? &table[key & tableMask] : NULL;
+    if (entry && entry->key == key) {
+        return entry->count;
+    }
+    uint64_t count = 0;
+    for (size_t i = 0; i < moves.size; i++) {
+        struct MoveUndo undo;
+        boardMakeChainedMove(gameboard, moves.moves[i], forceCapture, &undo);
+        if (checkMoves) {
+            checkChain(gameboard, forceCapture, moves.moves[i], &undo);
+        }
+        if (undo.chained) {
+            count += perft(gameboard, forceCapture, depth, moves.moves[i].to);
+        } else {
+            count += depth == 1 ? 1 : perft(gameboard, forceCapture, depth - 1, -1);
+        }
+        boardUnmakeMove(gameboard, &undo);
+    }
+    if (entry) {
+        entry->key = key;
+        entry->count = count;
+    }
+    return count;
+}
+
+/* one line per whole move, "32x21x12", with the count below it */
+static void printDivide(struct Board* gameboard, int forceCapture, int depth, int chain, char* path, size_t length, size_t* moveCount, uint64_t* total) {
+    struct MoveList moves;
+    if (chain >= 0) {
+        boardGenerateChainMoves(gameboard, chain, forceCapture, &moves);
+    } else {
+        boardGenerateMoves(gameboard, gameboard->sideToMove, forceCapture, &moves);
+    }
+    for (size_t i = 0; i < moves.size; i++) {
+        struct Move move = moves.moves[i];
+        int written = chain >= 0
+            ? snprintf(path + length, 256 - length, "x%d", boardNumberFromSquare(move.to))
+            : snprintf(path, 256, "%2d%c%d", boardNumberFromSquare(move.from), move.captured == CHECKERS_NO_SQUARE ? '-' : 'x', boardNumberFromSquare(move.to));
+        struct MoveUndo undo;
+        boardMakeChainedMove(gameboard, move, forceCapture, &undo);
+        if (undo.chained) {
+            printDivide(gameboard, forceCapture, depth, move.to, path, length + written, moveCount, total);
+        } else {
+            uint64_t nodes = depth == 1 ? 1 : perft(gameboard, forceCapture, depth - 1, -1);
+            *moveCount += 1;
+            *total += nodes;
+            printf("%s %llu\n", path, (unsigned long long) nodes);
+        }
+        boardUnmakeMove(gameboard, &undo);
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    int depth = 6;
+    int forceCapture = 1;
+    int divide = 0;
+    size_t megabytes = 0;
+    const char* fen = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            fen = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0) {
+            forceCapture = 0;
+        } else if (strcmp(argv[i], "-D") == 0) {
+            divide = 1;
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            megabytes = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            checkMoves = 1;
+        } else {
+            printf("Usage: %s [-d depth] [-f fen] [-n] [-D] [-H megabytes] [-c]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct Board board;
+    boardInit(&board);
+    if (fen && !boardLoadFen(&board, fen)) {
+        printf("Invalid position: %s\n", fen);
+        return 1;
+    }
+    if (megabytes > 0) {
+        size_t count = 1;
+        while (count * 2 * sizeof(struct PerftEntry) <= megabytes * 1024 * 1024) {
+            count *= 2;
+        }
+        table = calloc(count, sizeof(struct PerftEntry));
+        if (!table) {
+            printf("Could not allocate the hash table\n");
+            return 1;
+        }
+        tableMask = count - 1;
+    }
+
+    char text[512];
+    boardWriteFen(&board, text, sizeof(text));
+    printf("Position: %s\nForced captures: %s\n\n", text, forceCapture ? "yes" : "no");
+
+    for (int d = 1; d <= depth; d++) {
+        clock_t begin = clock();
+        uint64_t nodes = perft(&board, forceCapture, d, -1);
+        double seconds = (double) (clock() - begin) / CLOCKS_PER_SEC;
+        printf("perft(%2d) = %14llu  %8.3fs  %12.0f nodes/s\n", d, (unsigned long long) nodes, seconds, seconds > 0 ? nodes / seconds : 0.0);
+    }
+
+    if (divide && depth > 0) {
+        printf("\n");
+        char path[256];
+        size_t moveCount = 0;
+        uint64_t total = 0;
+        printDivide(&board, forceCapture, depth, -1, path, 0, &moveCount, &total);
+        printf("moves: %zu  total: %llu\n", moveCount, (unsigned long long) total);
+    }
+
+    if (checkMoves) {
+        printf("\n%llu mismatches\n", (unsigned long long) mismatches);
+    }
+    free(table);
+    return mismatches > 0;
+}
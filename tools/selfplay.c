@@ -0,0 +1,589 @@
+#include "checkers.h"
+#include "checkers_ai.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/**
+ * selfplay: plays two engine configurations, A and B, against each other over
+ * many games at once and reports the result as Elo, to check that a change
+ * to the engine is an improvement before it goes in.
+ *
+ * Usage: selfplay [-a spec] [-b spec] [-g games] [-j games] [-f file] [-r plies]
+ *                 [-s seed] [-l plies] [-S elo0,elo1] [-n]
+ *   -a, -b  engine configurations, comma separated key=value pairs out of
+ *           depth, ms and nodes (limits per move), gms and gnodes (budgets
+ *           per game, replacing ms and nodes), inc (milliseconds added to gms
+ *           after each move), tt (megabytes), threads, tb (tablebase
+ *           directory) and book (book file); default "depth=6"
+ *   -g  games, played in pairs from the same opening with colours swapped (default 1000)
+ *   -j  games played at once (default one per core)
+ *   -f  openings, one PDN FEN per line, used in turn
+ *   -r  without -f, each opening is this many random plies from the start (default 6)
+ *   -s  seed of the random openings, the same seed gives the same openings (default 1)
+ *   -l  plies after which a game is a draw (default 300)
+ *   -S  stop once a sequential probability ratio test tells whether A is elo0
+ *       or elo1 stronger than B, with 5% error either way
+ *   -n  captures are not forced
+ *
+ * A side that cannot move loses, and a position seen for the third time with
+ * the same side to move is a draw. An engine with a game budget gets an even
+ * share of what it has left for each move, and loses once its searches have
+ * used more than the budget. Results are given from A's side.
+ */
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+
+typedef uintptr_t spthread;
+typedef CRITICAL_SECTION spmutex;
+#define THREAD_RETURN unsigned __stdcall
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t spthread;
+typedef pthread_mutex_t spmutex;
+#define THREAD_RETURN void*
+
+#endif
+
+#define MAX_JOBS        256
+#define MAX_GAME_PLIES  4096
+#define SPRT_ERROR      0.05
+#define EXPECTED_PLIES  160     /* of a game, for sharing out the game budgets */
+#define MIN_MOVES_LEFT  10
+
+/* an engine's configuration and its budgets for a whole game, 0 for none */
+struct Engine {
+    struct AiConfig config;
+    unsigned int gameMs;
+    unsigned int incrementMs;
+    uint64_t gameNodes;
+};
+
+/* everything the workers share, the counters are guarded by mutex */
+struct Match {
+    struct Engine engines[2];
+    struct Board* openings;     /* NULL for random ones */
+    size_t openingsSize;
+    int randomPlies;
+    uint64_t seed;
+    int maxPlies;
+    int games;
+    int sprt;
+    double elo0, elo1;
+
+    int next;           /* the next game to hand out */
+    int wins, draws, losses;
+    int errors;         /* games an engine had no move in, counted as its loss */
+    int overBudget;     /* games an engine used up its game budget in, counted as its loss */
+    int decided;        /* 1 once the test accepted elo1, -1 once it accepted elo0 */
+    uint64_t plies;
+    double start;       /* wall clock seconds */
+    spmutex mutex;
+};
+
+struct Worker {
+    struct Match* match;
+    spthread tid;
+};
+
+static int forceCapture = 1;
+
+static inline void lockMatch(struct Match* match) {
+    #ifdef _WIN32
+    EnterCriticalSection(&match->mutex);
+    #else
+    pthread_mutex_lock(&match->mutex);
+    #endif
+}
+
+static inline void unlockMatch(struct Match* match) {
+    #ifdef _WIN32
+    LeaveCriticalSection(&match->mutex);
+    #else
+    pthread_mutex_unlock(&match->mutex);
+    #endif
+}
+
+static int coreCount(void) {
+    #ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int) info.dwNumberOfProcessors;
+    #else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int) cores : 1;
+    #endif
+}
+
+static double wallSeconds(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static double scoreFromElo(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+static double eloFromScore(double score) {
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+/* the share of points and its variance per game */
+static void scoreOf(int wins, int draws, int losses, double* score, double* variance) {
+    double games = wins + draws + losses;
+    *score = (wins + 0.5 * draws) / games;
+    *variance = (wins * (1.0 - *score) * (1.0 - *score) + draws * (0.5 - *score) * (0.5 - *score) + losses * *score * *score) / games;
+}
+
+/**
+ * Log-likelihood ratio of elo1 against elo0, with the results taken as normally
+ * distributed around their mean score; it needs a win and a loss to say anything.
+ */
+static double sprtLlr(int wins, int draws, int losses, double elo0, double elo1) {
+    if (wins == 0 || losses == 0) {
+        return 0.0;
+    }
+    double score, variance;
+    scoreOf(wins, draws, losses, &score, &variance);
+    double s0 = scoreFromElo(elo0);
+    double s1 = scoreFromElo(elo1);
+    return (wins + draws + losses) * (s1 - s0) * (2.0 * score - s0 - s1) / (2.0 * variance);
+}
+
+/* the Elo of A and the half width of its 95% interval */
+static void eloOf(int wins, int draws, int losses, double* elo, double* margin) {
+    double score, variance;
+    scoreOf(wins, draws, losses, &score, &variance);
+    double deviation = 1.96 * sqrt(variance / (wins + draws + losses));
+    double low = score - deviation > 0.0 ? score - deviation : 0.0;
+    double high = score + deviation < 1.0 ? score + deviation : 1.0;
+    *elo = eloFromScore(score);
+    *margin = low > 0.0 && high < 1.0 ? (eloFromScore(high) - eloFromScore(low)) / 2.0 : HUGE_VAL;
+}
+
+/* "depth=8,ms=100" and the like into engine, cutting spec up in place; 0 on an unknown key */
+static int parseEngine(char* spec, struct Engine* engine) {
+    struct AiConfig* config = &engine->config;
+    char* next = spec;
+    while (next && *next) {
+        char* pair = next;
+        next = strchr(pair, ',');
+        if (next) {
+            *next++ = '\0';
+        }
+        char* value = strchr(pair, '=');
+        if (!value) {
+            return 0;
+        }
+        *value++ = '\0';
+        if (strcmp(pair, "depth") == 0) {
+            config->maxDepth = atoi(value);
+        } else if (strcmp(pair, "ms") == 0) {
+            config->timeMs = (unsigned int) atoi(value);
+        } else if (strcmp(pair, "nodes") == 0) {
+            config->nodeLimit = strtoull(value, NULL, 10);
+        } else if (strcmp(pair, "gms") == 0) {
+            engine->gameMs = (unsigned int) atoi(value);
+        } else if (strcmp(pair, "gnodes") == 0) {
+            engine->gameNodes = strtoull(value, NULL, 10);
+        } else if (strcmp(pair, "inc") == 0) {
+            engine->incrementMs = (unsigned int) atoi(value);
+        } else if (strcmp(pair, "tt") == 0) {
+            config->ttMegabytes = (size_t) atoi(value);
+        } else if (strcmp(pair, "threads") == 0) {
+            config->threads = atoi(value);
+        } else if (strcmp(pair, "tb") == 0) {
+            config->tablebasePath = value;
+        } else if (strcmp(pair, "book") == 0) {
+            config->bookPath = value;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void printEngine(const char* name, const struct Engine* engine) {
+    const struct AiConfig* config = &engine->config;
+    printf("%s: depth %d, %u ms, %llu nodes, %zu MB, %d threads, tablebases %s, book %s\n", name,
+        config->maxDepth, config->timeMs, (unsigned long long) config->nodeLimit, config->ttMegabytes,
+        config->threads, config->tablebasePath ? config->tablebasePath : "none", config->bookPath ? config->bookPath : "none");
+    if (engine->gameMs || engine->gameNodes) {
+        printf("   per game: %u ms + %u ms a move, %llu nodes\n", engine->gameMs, engine->incrementMs, (unsigned long long) engine->gameNodes);
+    }
+}
+
+/* an even share of what is left over the moves the game is expected to last, plus the increment */
+static void shareBudget(struct Ai* ai, const struct Engine* engine, int plies, int64_t leftMs, int64_t leftNodes) {
+    int64_t movesLeft = (EXPECTED_PLIES - plies) / 2;
+    movesLeft = movesLeft > MIN_MOVES_LEFT ? movesLeft : MIN_MOVES_LEFT;
+    unsigned int timeMs = engine->config.timeMs;
+    uint64_t nodeLimit = engine->config.nodeLimit;
+    // a limit of 0 means none, the last share is still one
+    if (engine->gameMs) {
+        int64_t share = leftMs / movesLeft + engine->incrementMs;
+        share = share < leftMs ? share : leftMs;
+        timeMs = share > 1 ? (unsigned int) share : 1;
+    }
+    // the node limit holds for each search thread on its own
+    if (engine->gameNodes) {
+        int threads = engine->config.threads > 1 ? engine->config.threads : 1;
+        int64_t share = leftNodes / movesLeft / threads;
+        nodeLimit = share > 1 ? (uint64_t) share : 1;
+    }
+    checkersAiSetLimits(ai, engine->config.maxDepth, timeMs, nodeLimit);
+}
+
+static int loadOpenings(struct Match* match, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 0;
+    }
+    size_t capacity = 0;
+    char line[512];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        if (match->openingsSize == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            struct Board* openings = realloc(match->openings, capacity * sizeof(struct Board));
+            if (!openings) {
+                fclose(file);
+                return 0;
+            }
+            match->openings = openings;
+        }
+        if (!boardLoadFen(&match->openings[match->openingsSize], line)) {
+            fprintf(stderr, "%s:%d: not a position, skipped\n", path, lineNumber);
+            continue;
+        }
+        match->openingsSize++;
+    }
+    fclose(file);
+    if (match->openingsSize == 0) {
+        fprintf(stderr, "%s: no positions\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/* plies random moves from the start, carried on to the end of a capture; 0 if the game ended on the way */
+static int randomOpening(struct Board* out, uint64_t seed, int plies) {
+    struct Checkers game;
+    checkersInit(&game, forceCapture, 0);
+    uint64_t x = seed * 0x9E3779B97F4A7C15ULL | 1;
+    int player = -1;
+    for (int i = 0; game.flags.run && (i < plies || checkersGetCurrentPlayer(&game) == player); i++) {
+        struct MoveList moves;
+        if (checkersGenerateMoves(&game, &moves) == 0) {
+            return 0;
+        }
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        struct Move move = moves.moves[(x >> 11) % moves.size];
+        player = checkersGetCurrentPlayer(&game);
+        if (checkersMakeMove(&game, boardPointFromSquare(move.from), boardPointFromSquare(move.to)) <= 0) {
+            return 0;
+        }
+    }
+    if (!game.flags.run) {
+        return 0;
+    }
+    *out = game.checkersBoard;
+    return 1;
+}
+
+static void openingFor(struct Match* match, int pair, struct Board* out) {
+    if (match->openings) {
+        *out = match->openings[(size_t) pair % match->openingsSize];
+        return;
+    }
+    uint64_t seed = match->seed * 1000003ULL + (uint64_t) pair;
+    while (!randomOpening(out, seed, match->randomPlies)) {
+        seed += 0x10000000ULL;
+    }
+}
+
+/**
+ * The engine that won, 0 for A and 1 for B, or -1 for a draw; *error is set if
+ * an engine had no move, *overBudget if one used up its game budget.
+ */
+static int playGame(struct Match* match, const struct Board* opening, int lightEngine, int* plies, int* error, int* overBudget) {
+    struct Checkers game;
+    checkersInit(&game, forceCapture, 0);
+    game.checkersBoard = *opening;
+    game.state = opening->sideToMove == CHECKERS_PLAYER_ONE ? CSTATE_P1_TURN : CSTATE_P2_TURN;
+    int engineOf[2] = { lightEngine, !lightEngine };
+    struct Ai* ais[2] = {
+        checkersAiCreateEx(&game, &match->engines[0].config),
+        checkersAiCreateEx(&game, &match->engines[1].config)
+    };
+    // what each engine has left of its game budgets
+    int64_t leftMs[2] = { match->engines[0].gameMs, match->engines[1].gameMs };
+    int64_t leftNodes[2] = { (int64_t) match->engines[0].gameNodes, (int64_t) match->engines[1].gameNodes };
+    uint64_t seen[MAX_GAME_PLIES];
+    size_t seenSize = 0;
+    int winner = -1;
+    *plies = 0;
+    *error = 0;
+    *overBudget = 0;
+    while (ais[0] && ais[1] && game.flags.run && *plies < match->maxPlies) {
+        int player = checkersGetCurrentPlayer(&game);
+        struct MoveList moves;
+        if (checkersGenerateMoves(&game, &moves) == 0) {
+            winner = engineOf[!player];
+            break;
+        }
+        int engine = engineOf[player];
+        const struct Engine* budget = &match->engines[engine];
+        if (budget->gameMs || budget->gameNodes) {
+            shareBudget(ais[engine], budget, *plies, leftMs[engine], leftNodes[engine]);
+        }
+        struct AiMoves move = checkersAiGenMovesSync(ais[engine]);
+        struct AiStats stats;
+        if ((budget->gameMs || budget->gameNodes) && checkersAiGetStats(ais[engine], &stats)) {
+            leftMs[engine] -= (int64_t) stats.elapsedMs;
+            leftNodes[engine] -= (int64_t) stats.nodes;
+            if ((budget->gameMs && leftMs[engine] < 0) || (budget->gameNodes && leftNodes[engine] < 0)) {
+                winner = engineOf[!player];
+                *overBudget = 1;
+                break;
+            }
+            leftMs[engine] += budget->incrementMs;
+        }
+        int kind = boardPieceAt(&game.checkersBoard, boardSquareFromPoint(move.from));
+        int pieces = boardRemainingPiecesTotal(&game.checkersBoard);
+        if (!move.valid || checkersMakeMove(&game, move.from, move.to) <= 0) {
+            winner = engineOf[!player];
+            *error = 1;
+            break;
+        }
+        *plies += 1;
+        if (!game.flags.run) {
+            winner = engineOf[checkersGetWinner(&game)];
+            break;
+        }
+        // men only go forward and captures cannot be undone, so nothing before either can come back
+        if (kind == PIECE_LIGHT_MAN || kind == PIECE_DARK_MAN || boardRemainingPiecesTotal(&game.checkersBoard) != pieces) {
+            seenSize = 0;
+        }
+        if (checkersGetCurrentPlayer(&game) != player) {
+            int repeated = 0;
+            for (size_t i = 0; i < seenSize; i++) {
+                repeated += seen[i] == game.checkersBoard.hash;
+            }
+            if (repeated >= 2) {
+                break;
+            }
+            if (seenSize < MAX_GAME_PLIES) {
+                seen[seenSize++] = game.checkersBoard.hash;
+            }
+        }
+    }
+    if (!ais[0] || !ais[1]) {
+        *error = 1;
+    }
+    checkersAiKill(ais[0]);
+    checkersAiKill(ais[1]);
+    return winner;
+}
+
+static void printProgress(struct Match* match) {
+    int played = match->wins + match->draws + match->losses;
+    double elo, margin;
+    eloOf(match->wins, match->draws, match->losses, &elo, &margin);
+    printf("\r%d/%d games: +%d =%d -%d, Elo %+.1f +- %.1f", played, match->games,
+        match->wins, match->draws, match->losses, elo, margin);
+    if (match->sprt) {
+        printf(", LLR %.2f", sprtLlr(match->wins, match->draws, match->losses, match->elo0, match->elo1));
+    }
+    printf(", %.2f games/s   ", played / (wallSeconds() - match->start));
+    fflush(stdout);
+}
+
+static THREAD_RETURN runWorker(void* arg) {
+    struct Worker* worker = (struct Worker*) arg;
+    struct Match* match = worker->match;
+    for (;;) {
+        lockMatch(match);
+        int index = match->decided ? match->games : match->next++;
+        unlockMatch(match);
+        if (index >= match->games) {
+            break;
+        }
+        // both games of a pair start from the same position, A has the light pieces in the first
+        struct Board opening;
+        openingFor(match, index / 2, &opening);
+        int plies, error, overBudget;
+        int winner = playGame(match, &opening, index & 1, &plies, &error, &overBudget);
+
+        lockMatch(match);
+        match->wins += winner == 0;
+        match->losses += winner == 1;
+        match->draws += winner < 0;
+        match->errors += error;
+        match->overBudget += overBudget;
+        match->plies += (uint64_t) plies;
+        if (match->sprt && !match->decided) {
+            double llr = sprtLlr(match->wins, match->draws, match->losses, match->elo0, match->elo1);
+            if (llr >= log((1.0 - SPRT_ERROR) / SPRT_ERROR)) {
+                match->decided = 1;
+            } else if (llr <= log(SPRT_ERROR / (1.0 - SPRT_ERROR))) {
+                match->decided = -1;
+            }
+        }
+        printProgress(match);
+        unlockMatch(match);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    struct Match match = {
+        .randomPlies = 6,
+        .seed = 1,
+        .maxPlies = 300,
+        .games = 1000
+    };
+    for (int e = 0; e < 2; e++) {
+        match.engines[e] = (struct Engine){
+            .config = {
+                .ttMegabytes = 4,
+                .maxDepth = 6,
+                .threads = 1
+            }
+        };
+    }
+    const char* openingsPath = NULL;
+    int jobs = coreCount();
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "-b") == 0) && i + 1 < argc) {
+            struct Engine* engine = &match.engines[argv[i][1] == 'b'];
+            if (!parseEngine(argv[++i], engine)) {
+                fprintf(stderr, "bad engine configuration, expected key=value pairs of depth, ms, nodes, gms, gnodes, inc, tt, threads, tb and book\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            match.games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            openingsPath = argv[++i];
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            match.randomPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            match.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            match.maxPlies = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf,%lf", &match.elo0, &match.elo1) != 2 || match.elo0 >= match.elo1) {
+                fprintf(stderr, "-S takes elo0,elo1 with elo0 below elo1\n");
+                return 1;
+            }
+            match.sprt = 1;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            forceCapture = 0;
+        } else {
+            fprintf(stderr, "usage: %s [-a spec] [-b spec] [-g games] [-j games] [-f file] [-r plies] [-s seed] [-l plies] [-S elo0,elo1] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (match.games < 1 || match.maxPlies < 1 || match.maxPlies > MAX_GAME_PLIES || match.randomPlies < 0) {
+        fprintf(stderr, "games must be positive, plies between 1 and %d\n", MAX_GAME_PLIES);
+        return 1;
+    }
+    if (openingsPath && !loadOpenings(&match, openingsPath)) {
+        return 1;
+    }
+    jobs = jobs < 1 ? 1 : jobs > MAX_JOBS ? MAX_JOBS : jobs;
+    jobs = jobs > match.games ? match.games : jobs;
+    printEngine("A", &match.engines[0]);
+    printEngine("B", &match.engines[1]);
+    printf("%d games, %d at once, ", match.games, jobs);
+    if (match.openings) {
+        printf("%zu openings from %s\n", match.openingsSize, openingsPath);
+    } else {
+        printf("openings of %d random plies, seed %llu\n", match.randomPlies, (unsigned long long) match.seed);
+    }
+
+    #ifdef _WIN32
+    InitializeCriticalSection(&match.mutex);
+    #else
+    pthread_mutex_init(&match.mutex, NULL);
+    #endif
+    struct Worker workers[MAX_JOBS];
+    int started = 0;
+    match.start = wallSeconds();
+    for (int i = 0; i < jobs; i++) {
+        workers[i].match = &match;
+        #ifdef _WIN32
+        workers[i].tid = _beginthreadex(NULL, 0, runWorker, &workers[i], 0, NULL);
+        int ok = workers[i].tid != 0;
+        #else
+        int ok = pthread_create(&workers[i].tid, NULL, runWorker, &workers[i]) == 0;
+        #endif
+        if (!ok) {
+            break;
+        }
+        started++;
+    }
+    // with no thread at all, the games are played here
+    if (started == 0) {
+        workers[0].match = &match;
+        runWorker(&workers[0]);
+    }
+    for (int i = 0; i < started; i++) {
+        #ifdef _WIN32
+        WaitForSingleObject((HANDLE) workers[i].tid, INFINITE);
+        CloseHandle((HANDLE) workers[i].tid);
+        #else
+        pthread_join(workers[i].tid, NULL);
+        #endif
+    }
+    double seconds = wallSeconds() - match.start;
+    #ifdef _WIN32
+    DeleteCriticalSection(&match.mutex);
+    #else
+    pthread_mutex_destroy(&match.mutex);
+    #endif
+
+    int played = match.wins + match.draws + match.losses;
+    double score, variance, elo, margin;
+    scoreOf(match.wins, match.draws, match.losses, &score, &variance);
+    eloOf(match.wins, match.draws, match.losses, &elo, &margin);
+    printf("\n\nA against B: %d games, +%d =%d -%d, %.1f%%", played, match.wins, match.draws, match.losses, 100.0 * score);
+    if (match.errors) {
+        printf(", %d lost for want of a move", match.errors);
+    }
+    if (match.overBudget) {
+        printf(", %d lost on the game budget", match.overBudget);
+    }
+    printf("\nElo %+.1f +- %.1f (95%%)\n", elo, margin);
+    if (match.sprt) {
+        double llr = sprtLlr(match.wins, match.draws, match.losses, match.elo0, match.elo1);
+        printf("SPRT elo0 %.1f elo1 %.1f: LLR %.2f (%.2f, %.2f), %s\n", match.elo0, match.elo1, llr,
+            log(SPRT_ERROR / (1.0 - SPRT_ERROR)), log((1.0 - SPRT_ERROR) / SPRT_ERROR),
+            match.decided > 0 ? "elo1 accepted" : match.decided < 0 ? "elo0 accepted" : "undecided");
+    }
+    printf("%.1f s, %.2f games/s, %.0f plies/s\n", seconds, played / seconds, match.plies / seconds);
+    free(match.openings);
+    return 0;
+}
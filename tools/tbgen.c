@@ -0,0 +1,380 @@
+#include "checkers.h"
+#include "checkers_tb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * tbgen: solves every endgame up to a number of pieces and writes one
+ * tablebase file per material signature, for tbOpen to map.
+ *
+ * Usage: tbgen [-p pieces] [-o directory] [-t threads] [-n]
+ *   -p  largest number of pieces on the board (default 4)
+ *   -o  directory the files are written to, must exist (default tablebases)
+ *   -t  worker threads (default 4)
+ *   -n  captures are not forced, probing only uses files built the same way
+ *
+ * Signatures are solved smallest first, and with the same number of pieces,
+ * fewest men first, so every capture or promotion lands in a solved one. A
+ * ply is a whole turn, so a capture the same piece goes on with is followed
+ * to its end.
+ *
+ * Within a signature the solving is retrograde. A first pass generates every
+ * turn once: turns into solved signatures are looked up, and the quiet moves
+ * that stay in the signature are only counted. Pass k then takes the
+ * positions settled at distance k - 1 and walks their quiet moves backwards:
+ * a predecessor of a loss is a win in k, and a predecessor whose count of
+ * unsettled moves runs out has only losing moves, so it is a loss. Whatever
+ * is never settled is a draw.
+ */
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <process.h>
+
+typedef uintptr_t tbthread;
+#define THREAD_RETURN unsigned __stdcall
+
+#else
+
+#include <pthread.h>
+#include <time.h>
+
+typedef pthread_t tbthread;
+#define THREAD_RETURN void*
+
+#endif
+
+#define MAX_THREADS 64
+#define SIGNATURES  ((TB_MAX_PIECES + 1) * (TB_MAX_PIECES + 1) * (TB_MAX_PIECES + 1) * (TB_MAX_PIECES + 1))
+
+/* in quickestWin, no move reaches a loss; in slowestLoss, some move reaches a draw or a loss */
+#define NO_DISTANCE 0xFF
+
+static uint8_t* solved[SIGNATURES];
+static uint64_t solvedPositions[SIGNATURES];
+static int forceCapture = 1;
+
+/**
+ * What the first pass leaves for the others, per position and side to move:
+ * the quiet moves not settled yet, the distance of the quickest win a turn
+ * into a solved signature gives, and the distance of the loss if every move
+ * turns out to lose, as far as the solved signatures tell.
+ */
+struct Pass {
+    const int* counts;
+    uint8_t* values;
+    uint8_t* unsettled;
+    uint8_t* quickestWin;
+    uint8_t* slowestLoss;
+    uint64_t positions;
+    uint64_t begin, end;
+    int k;          /* 0 generates the turns */
+    int highest;    /* largest value or quickestWin a later pass has to look at */
+    tbthread tid;
+};
+
+static inline uint64_t clockMs(void) {
+    #ifdef _WIN32
+    return GetTickCount64();
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    #endif
+}
+
+static inline int signatureOf(const int counts[4]) {
+    return ((counts[0] * (TB_MAX_PIECES + 1) + counts[1]) * (TB_MAX_PIECES + 1) + counts[2]) * (TB_MAX_PIECES + 1) + counts[3];
+}
+
+/* the value of a position in a signature solved earlier */
+static inline uint8_t lookup(struct Board* gameboard) {
+    int own = gameboard->sideToMove == CHECKERS_PLAYER_TWO ? gameboard->remainingDarkPieces : gameboard->remainingLightPieces;
+    if (own == 0) {
+        return 1;
+    }
+    int counts[4];
+    tbSignature(gameboard, counts);
+    int signature = signatureOf(counts);
+    return solved[signature][gameboard->sideToMove * solvedPositions[signature] + tbIndex(gameboard)];
+}
+
+struct Turns {
+    int quiet;      /* moves that stay in the signature */
+    int quickestWin;
+    int slowestLoss;
+};
+
+/* every way the side to move can end its turn from moves; a capture or a promotion always leaves the signature */
+static void scanTurns(struct Board* gameboard, const struct MoveList* moves, int first, struct Turns* turns) {
+    for (size_t i = 0; i < moves->size; i++) {
+        struct MoveUndo undo;
+        boardMakeChainedMove(gameboard, moves->moves[i], forceCapture, &undo);
+        if (undo.chained) {
+            struct MoveList next;
+            boardGenerateChainMoves(gameboard, moves->moves[i].to, forceCapture, &next);
+            scanTurns(gameboard, &next, 0, turns);
+        } else if (first && moves->moves[i].captured == CHECKERS_NO_SQUARE && !undo.promoted) {
+            turns->quiet++;
+        } else {
+            uint8_t reached = lookup(gameboard);
+            if (reached == TB_VALUE_DRAW) {
+                turns->slowestLoss = NO_DISTANCE;
+            } else if ((reached - 1) % 2 == 0) {
+                turns->slowestLoss = NO_DISTANCE;
+                turns->quickestWin = reached < turns->quickestWin ? reached : turns->quickestWin;
+            } else if (turns->slowestLoss != NO_DISTANCE && reached > turns->slowestLoss) {
+                turns->slowestLoss = reached;
+            }
+        }
+        boardUnmakeMove(gameboard, &undo);
+    }
+}
+
+/* values past the longest distance a file can hold are left as draws */
+static inline void settle(struct Pass* pass, uint64_t slot, int value) {
+    uint8_t expected = TB_VALUE_DRAW;
+    if (value <= TB_MAX_DISTANCE + 1 && __atomic_compare_exchange_n(&pass->values[slot], &expected, (uint8_t) value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        pass->highest = value > pass->highest ? value : pass->highest;
+    }
+}
+
+static void firstPass(struct Pass* pass, uint64_t index, const uint64_t pieces[4]) {
+    struct Board board;
+    struct MoveList moves;
+    for (int side = 0; side < 2; side++) {
+        uint64_t slot = side * pass->positions + index;
+        boardSetPieces(&board, pieces, side);
+        boardGenerateMoves(&board, side, forceCapture, &moves);
+        struct Turns turns = { .quiet = 0, .quickestWin = NO_DISTANCE, .slowestLoss = 0 };
+        scanTurns(&board, &moves, 1, &turns);
+        pass->values[slot] = TB_VALUE_DRAW;
+        pass->unsettled[slot] = turns.quiet;
+        pass->quickestWin[slot] = turns.quickestWin;
+        pass->slowestLoss[slot] = turns.slowestLoss;
+        if (moves.size == 0) {
+            settle(pass, slot, 1);
+        } else if (turns.quiet == 0 && turns.quickestWin != NO_DISTANCE) {
+            settle(pass, slot, turns.quickestWin + 1);
+        } else if (turns.quiet == 0 && turns.slowestLoss != NO_DISTANCE) {
+            settle(pass, slot, turns.slowestLoss + 1);
+        } else if (turns.quickestWin != NO_DISTANCE && turns.quickestWin > pass->highest) {
+            pass->highest = turns.quickestWin;
+        }
+    }
+}
+
+/* a man came one row back from its own side, a king from anywhere along an empty ray */
+static void settlePredecessors(struct Pass* pass, const uint64_t pieces[4], int side, int distance) {
+    struct Board board;
+    boardSetPieces(&board, pieces, side);
+    int mover = side == CHECKERS_PLAYER_ONE ? CHECKERS_PLAYER_TWO : CHECKERS_PLAYER_ONE;
+    int man = mover == CHECKERS_PLAYER_ONE ? PIECE_LIGHT_MAN : PIECE_DARK_MAN;
+    int back = mover == CHECKERS_PLAYER_ONE ? 1 : -1;  /* light men move up */
+    for (int kind = man; kind <= man + 1; kind++) {
+        for (uint64_t bits = pieces[kind]; bits; bits &= bits - 1) {
+            int square = __builtin_ctzll(bits);
+            struct Point to = boardPointFromSquare(square);
+            for (int dir = 0; dir < 4; dir++) {
+                int dx = dir % 2 ? 1 : -1;
+                int dy = dir < 2 ? -1 : 1;
+                if (kind == man && dy != back) {
+                    continue;
+                }
+                for (int step = 1; kind != man || step == 1; step++) {
+                    int from = boardSquareFromPoint((struct Point){ .x = to.x + dx * step, .y = to.y + dy * step });
+                    if (from < 0 || !((board.empty >> from) & 1)) {
+                        break;
+                    }
+                    uint64_t before[4] = { pieces[0], pieces[1], pieces[2], pieces[3] };
+                    before[kind] ^= 1ULL << square | 1ULL << from;
+                    struct Board predecessor;
+                    boardSetPieces(&predecessor, before, mover);
+                    // with forced captures the quiet move was not allowed there
+                    if (forceCapture && boardCheckIfPlayerCanCapture(&predecessor, mover)) {
+                        continue;
+                    }
+                    uint64_t slot = mover * pass->positions + tbIndex(&predecessor);
+                    if (distance % 2 == 0) {
+                        settle(pass, slot, distance + 2);
+                    } else if (__atomic_sub_fetch(&pass->unsettled[slot], 1, __ATOMIC_RELAXED) == 0 && pass->slowestLoss[slot] != NO_DISTANCE) {
+                        int loss = distance + 1 > pass->slowestLoss[slot] ? distance + 1 : pass->slowestLoss[slot];
+                        settle(pass, slot, loss + 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static THREAD_RETURN runPass(void* arg) {
+    struct Pass* pass = (struct Pass*) arg;
+    uint64_t pieces[4];
+    for (uint64_t index = pass->begin; index < pass->end; index++) {
+        if (pass->k == 0) {
+            if (tbUnindex(pass->counts, index, pieces)) {
+                firstPass(pass, index, pieces);
+            }
+            continue;
+        }
+        for (int side = 0; side < 2; side++) {
+            uint64_t slot = side * pass->positions + index;
+            // positions settled in this pass hold k + 1 and wait for the next one
+            uint8_t value = __atomic_load_n(&pass->values[slot], __ATOMIC_RELAXED);
+            if (value == TB_VALUE_DRAW && pass->quickestWin[slot] == pass->k) {
+                settle(pass, slot, pass->k + 1);
+            } else if (value == pass->k) {
+                tbUnindex(pass->counts, index, pieces);
+                settlePredecessors(pass, pieces, side, pass->k - 1);
+            }
+        }
+    }
+    return 0;
+}
+
+static int runPasses(struct Pass* passes, int threads) {
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        #ifdef _WIN32
+        passes[i].tid = _beginthreadex(NULL, 0, runPass, &passes[i], 0, NULL);
+        int ok = passes[i].tid != 0;
+        #else
+        int ok = pthread_create(&passes[i].tid, NULL, runPass, &passes[i]) == 0;
+        #endif
+        if (!ok) {
+            break;
+        }
+        started++;
+    }
+    // a thread that failed to start has its range done here
+    for (int i = started; i < threads; i++) {
+        runPass(&passes[i]);
+    }
+    for (int i = 0; i < started; i++) {
+        #ifdef _WIN32
+        WaitForSingleObject((HANDLE) passes[i].tid, INFINITE);
+        CloseHandle((HANDLE) passes[i].tid);
+        #else
+        pthread_join(passes[i].tid, NULL);
+        #endif
+    }
+    int highest = 0;
+    for (int i = 0; i < threads; i++) {
+        highest = passes[i].highest > highest ? passes[i].highest : highest;
+    }
+    return highest;
+}
+
+static int solve(const int counts[4], int threads, const char* directory) {
+    uint64_t start = clockMs();
+    uint64_t positions = tbSignatureSize(counts);
+    uint8_t* values = malloc(positions * 2);
+    uint8_t* work = malloc(positions * 2 * 3);
+    if (!values || !work) {
+        fprintf(stderr, "out of memory for %llu positions\n", (unsigned long long) positions * 2);
+        free(values);
+        free(work);
+        return -1;
+    }
+    memset(values, TB_VALUE_INVALID, positions * 2);
+    int signature = signatureOf(counts);
+
+    struct Pass passes[MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        passes[i] = (struct Pass){
+            .counts = counts,
+            .values = values,
+            .unsettled = work,
+            .quickestWin = work + positions * 2,
+            .slowestLoss = work + positions * 4,
+            .positions = positions,
+            .begin = positions * i / threads,
+            .end = positions * (i + 1) / threads
+        };
+    }
+    int highest = runPasses(passes, threads);
+    int k = 1;
+    for (; k <= highest && k <= TB_MAX_DISTANCE; k++) {
+        for (int i = 0; i < threads; i++) {
+            passes[i].k = k;
+        }
+        int reached = runPasses(passes, threads);
+        highest = reached > highest ? reached : highest;
+    }
+    free(work);
+    solved[signature] = values;
+    solvedPositions[signature] = positions;
+
+    uint64_t wins = 0, losses = 0, draws = 0;
+    int longest = 0;
+    for (uint64_t i = 0; i < positions * 2; i++) {
+        if (values[i] == TB_VALUE_INVALID) {
+            continue;
+        } else if (values[i] == TB_VALUE_DRAW) {
+            draws++;
+        } else {
+            int distance = values[i] - 1;
+            wins += distance % 2;
+            losses += distance % 2 == 0;
+            longest = distance > longest ? distance : longest;
+        }
+    }
+    char path[1024];
+    if (!tbFileName(path, sizeof(path), directory, counts) || !tbWriteFile(path, counts, forceCapture, values)) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return -1;
+    }
+    printf("%s: %llu wins, %llu losses, %llu draws, longest %d plies, %d passes, %.2fs\n", path,
+        (unsigned long long) wins, (unsigned long long) losses, (unsigned long long) draws, longest, k,
+        (clockMs() - start) / 1000.0);
+    fflush(stdout);
+    return longest;
+}
+
+int main(int argc, char** argv) {
+    int maxPieces = 4;
+    int threads = 4;
+    const char* directory = "tablebases";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            maxPieces = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            forceCapture = 0;
+        } else {
+            fprintf(stderr, "usage: %s [-p pieces] [-o directory] [-t threads] [-n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (maxPieces < 2 || maxPieces > TB_MAX_PIECES) {
+        fprintf(stderr, "pieces must be between 2 and %d\n", TB_MAX_PIECES);
+        return 1;
+    }
+    threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+
+    for (int total = 2; total <= maxPieces; total++) {
+        for (int men = 0; men <= total; men++) {
+            for (int light = 1; light < total; light++) {
+                int dark = total - light;
+                for (int lightMen = 0; lightMen <= light && lightMen <= men; lightMen++) {
+                    int darkMen = men - lightMen;
+                    if (darkMen > dark) {
+                        continue;
+                    }
+                    int counts[4] = { lightMen, light - lightMen, darkMen, dark - darkMen };
+                    if (solve(counts, threads, directory) < 0) {
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}